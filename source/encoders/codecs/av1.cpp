@@ -19,6 +19,10 @@
 // SOFTWARE.
 
 #include "av1.hpp"
+#include <algorithm>
+
+// libaom does not use more threads than this.
+#define ST_LAYOUT_THREADS_MAXIMUM 64
 
 const char* streamfx::encoder::codec::av1::profile_to_string(profile p)
 {
@@ -33,3 +37,34 @@ const char* streamfx::encoder::codec::av1::profile_to_string(profile p)
 		return "Unknown";
 	}
 }
+
+void streamfx::encoder::codec::av1::automatic_layout(layout& layout, uint32_t width, uint32_t height,
+													 uint32_t tile_size, std::size_t cores)
+{
+	// Split into as many tiles as there are cores, columns first as they parallelize better, but keep each tile large
+	// enough to not waste too much compression on the tile borders.
+	if (layout.tile_columns == -1) {
+		int8_t columns = 0;
+		while ((columns < 6) && ((width >> (columns + 1)) >= tile_size) && ((2ull << columns) <= cores)) {
+			columns++;
+		}
+		layout.tile_columns = columns;
+	}
+	if (layout.tile_rows == -1) {
+		int8_t rows = 0;
+		while ((rows < 6) && ((height >> (rows + 1)) >= tile_size)
+			   && ((2ull << (layout.tile_columns + rows)) <= cores)) {
+			rows++;
+		}
+		layout.tile_rows = rows;
+	}
+	std::size_t tiles = 1ull << (layout.tile_columns + layout.tile_rows);
+
+	// Row based multi-threading keeps the remaining cores busy with the rows of each tile.
+	if (layout.rowmultithreading == -1) {
+		layout.rowmultithreading = (cores > tiles) ? 1 : 0;
+	}
+
+	std::size_t threads = (layout.rowmultithreading == 1) ? cores : std::min(cores, tiles);
+	layout.threads      = static_cast<int8_t>(std::clamp<std::size_t>(threads, 1, ST_LAYOUT_THREADS_MAXIMUM));
+}
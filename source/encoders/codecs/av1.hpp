@@ -33,4 +33,22 @@ namespace streamfx::encoder::codec::av1 {
 	};
 
 	const char* profile_to_string(profile p);
+
+	/** Threads and tiles of an encoder, where -1 is left to be decided.
+	 */
+	struct layout {
+		int8_t threads;
+		int8_t rowmultithreading;
+		int8_t tile_columns;
+		int8_t tile_rows;
+	};
+
+	/** Decide the tiles, row based multi-threading and threads for the given frame size and cores.
+	 *
+	 * Tile columns and rows are counted in powers of two, like libaom does. Values other than -1 are kept, only the
+	 * threads are always decided.
+	 *
+	 * @param tile_size Smallest tile edge to create, as every tile costs some compression.
+	 */
+	void automatic_layout(layout& layout, uint32_t width, uint32_t height, uint32_t tile_size, std::size_t cores);
 } // namespace streamfx::encoder::codec::av1
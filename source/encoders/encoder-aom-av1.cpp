@@ -19,6 +19,7 @@
 // SOFTWARE.
 
 #include "encoder-aom-av1.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <thread>
 #include "util/util-logging.hpp"
@@ -37,6 +38,12 @@
 #define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
 #endif
 
+// libobs supports 10-bit formats and HDR color spaces since version 28. Built against anything older, the encoder never
+// sees I010, P010, PQ or HLG, and the P010 repack in copy_image() never runs.
+#if LIBOBS_API_MAJOR_VER >= 28
+#define ST_HIGH_BIT_DEPTH
+#endif
+
 #define ST_I18N "Encoder.AOM.AV1"
 
 // Preset
@@ -59,6 +66,8 @@
 #define ST_I18N_ENCODER_CPUUSAGE_9 ST_I18N_ENCODER ".CPUUsage.9"
 #define ST_I18N_ENCODER_CPUUSAGE_10 ST_I18N_ENCODER ".CPUUsage.10"
 #define ST_KEY_ENCODER_CPUUSAGE "Encoder.CPUUsage"
+#define ST_I18N_ENCODER_CPUUSAGE_ADAPTIVE ST_I18N_ENCODER_CPUUSAGE ".Adaptive"
+#define ST_KEY_ENCODER_CPUUSAGE_ADAPTIVE "Encoder.CPUUsage.Adaptive"
 #define ST_KEY_ENCODER_PROFILE "Encoder.Profile"
 
 // Rate Control
@@ -126,6 +135,30 @@
 #define ST_I18N_ADVANCED_TUNE_CONTENT_SCREEN ST_I18N_ADVANCED_TUNE_CONTENT ".Screen"
 #define ST_I18N_ADVANCED_TUNE_CONTENT_FILM ST_I18N_ADVANCED_TUNE_CONTENT ".Film"
 #define ST_KEY_ADVANCED_TUNE_CONTENT "Advanced.Tune.Content"
+#define ST_I18N_ADVANCED_CHUNKS ST_I18N_ADVANCED ".Chunks"
+#define ST_KEY_ADVANCED_CHUNKS "Advanced.Chunks"
+
+// Number of rows copied by a single task when copying frames in parallel.
+#define ST_COPY_ROWS_PER_TASK 64
+
+// Number of images frames are copied into. libaom copies every image into its own look-ahead buffer before
+// aom_codec_encode returns, so this does not need to grow with the look-ahead or the thread count.
+#define ST_IMAGE_RING_SIZE 2
+
+// Adaptive speed switches to a faster CPU usage above the high and back to a slower one below the low threshold, both
+// relative to the time available per frame. The gap between them keeps it from switching back and forth.
+#define ST_SPEED_THRESHOLD_HIGH 0.90
+#define ST_SPEED_THRESHOLD_LOW 0.60
+#define ST_SPEED_SMOOTHING 0.125
+
+// Smallest tile edge the automatic layout creates. Every tile costs some compression, which real time encoding can
+// afford more easily than the other usages.
+#define ST_LAYOUT_TILE_SIZE_REALTIME 256
+#define ST_LAYOUT_TILE_SIZE_QUALITY 512
+
+// Memory that chunked encoding may use for frames waiting to be encoded. Once it is used up, encoding waits for the
+// chunks to finish a frame, which slows OBS down to the speed of the encoder instead of using more memory.
+#define ST_CHUNK_MEMORY_LIMIT (2048ull << 20)
 
 using namespace streamfx::encoder::aom::av1;
 
@@ -158,6 +191,12 @@ const char* obs_video_format_to_string(video_format format)
 		return "BGR3";
 	case VIDEO_FORMAT_I422:
 		return "I422";
+#ifdef ST_HIGH_BIT_DEPTH
+	case VIDEO_FORMAT_I010:
+		return "I010";
+	case VIDEO_FORMAT_P010:
+		return "P010";
+#endif
 	case VIDEO_FORMAT_I40A:
 		return "I40A";
 	case VIDEO_FORMAT_I42A:
@@ -305,7 +344,10 @@ const char* aom_tune_content_to_string(aom_tune_content tune)
 
 aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bool is_hw)
 	: obs::encoder_instance(settings, self, is_hw), _factory(aom_av1_factory::get()), _iface(nullptr), _ctx(), _cfg(),
-	  _image_index(0), _images(), _global_headers(nullptr), _initialized(false), _settings()
+	  _image_index(0), _images(), _global_headers(nullptr), _packets(), _packet_buffers_lock(), _packet_buffers(),
+	  _packet(), _initialized(false), _settings(), _chunk_count(0), _chunk_length(0), _chunk_depth(0), _chunk_lock(),
+	  _chunk_submitted(), _chunk_completed(), _chunk_stop(false), _chunk_error(false), _chunks(), _chunk_images(),
+	  _chunk_images_allocated(0), _chunk_images_limit(0), _speed()
 {
 	if (is_hw) {
 		throw std::runtime_error("Hardware encoding isn't even registered, how did you get here?");
@@ -317,12 +359,10 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 		throw std::runtime_error("AOM library does not provide AV1 encoder.");
 	}
 
-#ifdef ENABLE_PROFILING
-	// Profilers
-	_profiler_copy   = streamfx::util::profiler::create();
-	_profiler_encode = streamfx::util::profiler::create();
-	_profiler_packet = streamfx::util::profiler::create();
-#endif
+	// Profilers, shared by all instances.
+	_profiler_copy   = streamfx::util::profiler::create("AV1 Copy");
+	_profiler_encode = streamfx::util::profiler::create("AV1 Encode");
+	_profiler_packet = streamfx::util::profiler::create("AV1 Packet");
 
 	{     // Generate Static Configuration
 		{ // OBS Information
@@ -342,6 +382,8 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 			_settings.fps.den = static_cast<uint32_t>(video_info->fps_den);
 
 			// Color Format
+			_settings.bit_depth          = 8;
+			_settings.chroma_interleaved = false;
 			switch (ovsi.format) {
 			case VIDEO_FORMAT_I420:
 				_settings.color_format = AOM_IMG_FMT_I420;
@@ -352,6 +394,17 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 			case VIDEO_FORMAT_I444:
 				_settings.color_format = AOM_IMG_FMT_I444;
 				break;
+#ifdef ST_HIGH_BIT_DEPTH
+			case VIDEO_FORMAT_I010:
+				_settings.color_format = AOM_IMG_FMT_I42016;
+				_settings.bit_depth    = 10;
+				break;
+			case VIDEO_FORMAT_P010:
+				_settings.color_format       = AOM_IMG_FMT_I42016;
+				_settings.bit_depth          = 10;
+				_settings.chroma_interleaved = true;
+				break;
+#endif
 			default:
 				throw std::runtime_error("Something went wrong figuring out our color format.");
 			}
@@ -373,6 +426,18 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 				_settings.color_trc       = AOM_CICP_TC_SRGB;
 				_settings.color_matrix    = AOM_CICP_MC_BT_709;
 				break;
+#ifdef ST_HIGH_BIT_DEPTH
+			case VIDEO_CS_2100_PQ:
+				_settings.color_primaries = AOM_CICP_CP_BT_2020;
+				_settings.color_trc       = AOM_CICP_TC_SMPTE_2084;
+				_settings.color_matrix    = AOM_CICP_MC_BT_2020_NCL;
+				break;
+			case VIDEO_CS_2100_HLG:
+				_settings.color_primaries = AOM_CICP_CP_BT_2020;
+				_settings.color_trc       = AOM_CICP_TC_HLG;
+				_settings.color_matrix    = AOM_CICP_MC_BT_2020_NCL;
+				break;
+#endif
 			}
 
 			// Color Range
@@ -414,11 +479,10 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 		{ // Threading
 			if (auto threads = obs_data_get_int(settings, ST_KEY_ADVANCED_THREADS); threads > 0) {
 				_settings.threads = static_cast<int8_t>(threads);
-			} else {
-				_settings.threads = std::thread::hardware_concurrency();
 			}
 			_settings.rowmultithreading =
 				static_cast<int8_t>(obs_data_get_int(settings, ST_KEY_ADVANCED_ROWMULTITHREADING));
+			_settings.chunks = static_cast<int8_t>(obs_data_get_int(settings, ST_KEY_ADVANCED_CHUNKS));
 		}
 
 		{ // Tiling
@@ -426,6 +490,23 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 			_settings.tile_rows    = static_cast<int8_t>(obs_data_get_int(settings, ST_KEY_ADVANCED_TILE_ROWS));
 		}
 
+		{ // Automatic Layout
+			_settings.layout_automatic = (obs_data_get_int(settings, ST_KEY_ADVANCED_THREADS) <= 0);
+			if (_settings.layout_automatic) {
+				// Chunks encode at the same time, so each one only gets a share of the cores.
+				std::size_t cores = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+				if (_settings.chunks > 1) {
+					cores = std::max<std::size_t>(cores / static_cast<std::size_t>(_settings.chunks), 1);
+				}
+
+				automatic_layout(static_cast<unsigned int>(obs_data_get_int(settings, ST_KEY_ENCODER_USAGE)), cores);
+				if (_settings.chunks > 1) {
+					_settings.threads = static_cast<int8_t>(
+						std::min<int32_t>(_settings.threads * _settings.chunks, std::numeric_limits<int8_t>::max()));
+				}
+			}
+		}
+
 		{ // Tuning
 			if (auto v = obs_data_get_int(settings, ST_KEY_ADVANCED_TUNE_METRIC); v != -1) {
 				_settings.tune_metric = static_cast<aom_tune_metric>(v);
@@ -439,147 +520,50 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 	update(settings);
 
 	// Initialize Encoder
-	if (auto error = _factory->libaom_codec_enc_init_ver(&_ctx, _iface, &_cfg, 0, AOM_ENCODER_ABI_VERSION);
+	aom_codec_flags_t flags = (_settings.bit_depth > 8) ? AOM_CODEC_USE_HIGHBITDEPTH : 0;
+	if (auto error = _factory->libaom_codec_enc_init_ver(&_ctx, _iface, &_cfg, flags, AOM_ENCODER_ABI_VERSION);
 		error != AOM_CODEC_OK) {
 		const char* errstr = _factory->libaom_codec_err_to_string(error);
 		D_LOG_ERROR("Failed to initialize codec, unexpected error: %s (code %" PRIu32 ")", errstr, error);
 		throw std::runtime_error(errstr);
 	}
 
-	{ // Apply Static Control Settings
-
-		{ // Color Information
-#ifdef AOM_CTRL_AV1E_SET_COLOR_PRIMARIES
-			if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_COLOR_PRIMARIES, _settings.color_primaries);
-				error != AOM_CODEC_OK) {
-				const char* errstr = _factory->libaom_codec_err_to_string(error);
-				const char* err    = _factory->libaom_codec_error(&_ctx);
-				const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-							  "AV1E_SET_COLOR_PRIMARIES",                             //
-							  (errstr ? errstr : ""), error,                          //
-							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-				);
-			}
-#else
-			D_LOG_ERROR("AOM library was built without AV1E_SET_COLOR_PRIMARIES, behavior is unknown.");
-#endif
-
-#ifdef AOM_CTRL_AV1E_SET_TRANSFER_CHARACTERISTICS
-			if (auto error =
-					_factory->libaom_codec_control(&_ctx, AV1E_SET_TRANSFER_CHARACTERISTICS, _settings.color_trc);
-				error != AOM_CODEC_OK) {
-				const char* errstr = _factory->libaom_codec_err_to_string(error);
-				const char* err    = _factory->libaom_codec_error(&_ctx);
-				const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-							  "AV1E_SET_TRANSFER_CHARACTERISTICS",                    //
-							  (errstr ? errstr : ""), error,                          //
-							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-				);
-			}
-#else
-			D_LOG_ERROR("AOM library was built without AV1E_SET_TRANSFER_CHARACTERISTICS, behavior is unknown.");
-#endif
-
-#ifdef AOM_CTRL_AV1E_SET_MATRIX_COEFFICIENTS
-			if (auto error =
-					_factory->libaom_codec_control(&_ctx, AV1E_SET_MATRIX_COEFFICIENTS, _settings.color_matrix);
-				error != AOM_CODEC_OK) {
-				const char* errstr = _factory->libaom_codec_err_to_string(error);
-				const char* err    = _factory->libaom_codec_error(&_ctx);
-				const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-							  "AV1E_SET_MATRIX_COEFFICIENTS",                         //
-							  (errstr ? errstr : ""), error,                          //
-							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-				);
-			}
-#else
-			D_LOG_ERROR("AOM library was built without AV1E_SET_MATRIX_COEFFICIENTS, behavior is unknown.");
-#endif
-
-#ifdef AOM_CTRL_AV1E_SET_COLOR_RANGE
-			if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_COLOR_RANGE, _settings.color_range);
-				error != AOM_CODEC_OK) {
-				const char* errstr = _factory->libaom_codec_err_to_string(error);
-				const char* err    = _factory->libaom_codec_error(&_ctx);
-				const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-							  "AV1E_SET_COLOR_RANGE",                                 //
-							  (errstr ? errstr : ""), error,                          //
-							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-				);
-			}
-#else
-			D_LOG_ERROR("AOM library was built without AV1_SET_COLOR_RANGE, behavior is unknown.");
-#endif
+	// Apply Static Control Settings
+	apply_static_controls(&_ctx);
 
-#ifdef AOM_CTRL_AV1E_SET_CHROMA_SAMPLE_POSITION
-			// !TODO: Consider making this user-controlled. At the moment, this follows the H.264 chroma standard.
-			if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_CHROMA_SAMPLE_POSITION, AOM_CSP_VERTICAL);
-				error != AOM_CODEC_OK) {
-				const char* errstr = _factory->libaom_codec_err_to_string(error);
-				const char* err    = _factory->libaom_codec_error(&_ctx);
-				const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-							  "AV1E_SET_CHROMA_SAMPLE_POSITION",                      //
-							  (errstr ? errstr : ""), error,                          //
-							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-				);
-			}
-#endif
-
-#ifdef AOM_CTRL_AV1E_SET_RENDER_SIZE
-			int32_t size[2] = {_settings.width, _settings.height};
-			if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_RENDER_SIZE, &size);
-				error != AOM_CODEC_OK) {
-				const char* errstr = _factory->libaom_codec_err_to_string(error);
-				const char* err    = _factory->libaom_codec_error(&_ctx);
-				const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-							  "AV1E_SET_RENDER_SIZE",                                 //
-							  (errstr ? errstr : ""), error,                          //
-							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-				);
-			}
-#endif
-		}
-
-		// Apply Dynamic Control Settings
-		if (!update(settings)) {
-			throw std::runtime_error("Unexpected error during configuration.");
-		}
+	// Apply Dynamic Control Settings
+	if (!update(settings)) {
+		throw std::runtime_error("Unexpected error during configuration.");
 	}
 
 	// Preallocate global headers.
 	_global_headers = _factory->libaom_codec_get_global_headers(&_ctx);
 
 	// Allocate frames.
-	_images.resize(_cfg.g_threads);
+	_images.resize(ST_IMAGE_RING_SIZE);
 	for (auto& image : _images) {
-		_factory->libaom_img_alloc(&image, _settings.color_format, _settings.width, _settings.height, 8);
+		prepare_image(image);
+	}
 
-		// Color Information.
-		image.fmt        = _settings.color_format;
-		image.cp         = _settings.color_primaries;
-		image.tc         = _settings.color_trc;
-		image.mc         = _settings.color_matrix;
-		image.range      = _settings.color_range;
-		image.monochrome = _settings.monochrome ? 1 : 0;
-		image.csp        = AOM_CSP_VERTICAL; // !TODO: Consider making this user-controlled.
+	// Chunked encoding splits the video at key-frames and encodes each part on its own encoder. This requires a fixed
+	// key-frame interval, and the delay it adds makes it only useful for recordings.
+	if (_settings.chunks > 1) {
+		if (_cfg.g_usage == AOM_USAGE_ALL_INTRA) {
+			D_LOG_WARNING("Chunked encoding is not useful with 'All Intra', ignoring.", "");
+		} else if (_settings.kf_distance_max <= 0) {
+			D_LOG_WARNING("Chunked encoding requires a fixed key-frame interval, ignoring.", "");
+		} else {
+			_chunk_count  = static_cast<std::size_t>(_settings.chunks);
+			_chunk_length = static_cast<std::size_t>(_settings.kf_distance_max);
+
+			// Every chunk that may be encoding, plus the one that is still being filled.
+			_chunk_depth = (_chunk_count + 1) * _chunk_length;
 
-		// Size
-		image.r_w = image.d_w;
-		image.r_h = image.d_h;
-		image.r_w = image.w;
-		image.r_h = image.h;
+			// Every chunk needs at least a few frames to be able to work at the same time as the others.
+			std::size_t bytes = static_cast<std::size_t>(_settings.width) * _settings.height * 3 / 2
+								* ((_settings.bit_depth > 8) ? 2 : 1);
+			_chunk_images_limit = std::max<std::size_t>(ST_CHUNK_MEMORY_LIMIT / bytes, _chunk_count * 2);
+		}
 	}
 
 	// Log Settings
@@ -591,29 +575,31 @@ aom_av1_instance::aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bo
 
 aom_av1_instance::~aom_av1_instance()
 {
-#ifdef ENABLE_PROFILING
-	// Profiling
-	D_LOG_INFO("Timings | Avg. µs       | 99.9ile µs    | 99.0ile µs    | 95.0ile µs    | Samples  ", "");
-	D_LOG_INFO("--------+---------------+---------------+---------------+---------------+----------", "");
-	D_LOG_INFO("Copy    | %13.1f | %13" PRId64 " | %13" PRId64 " | %13" PRId64 " | %9" PRIu64,
-			   _profiler_copy->average_duration() / 1000.,
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_copy->percentile(0.999)).count(),
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_copy->percentile(0.990)).count(),
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_copy->percentile(0.950)).count(),
-			   _profiler_copy->count());
-	D_LOG_INFO("Encode  | %13.1f | %13" PRId64 " | %13" PRId64 " | %13" PRId64 " | %9" PRIu64,
-			   _profiler_encode->average_duration() / 1000.,
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_encode->percentile(0.999)).count(),
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_encode->percentile(0.990)).count(),
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_encode->percentile(0.950)).count(),
-			   _profiler_encode->count());
-	D_LOG_INFO("Packet  | %13.1f | %13" PRId64 " | %13" PRId64 " | %13" PRId64 " | %9" PRIu64,
-			   _profiler_packet->average_duration() / 1000.,
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_packet->percentile(0.999)).count(),
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_packet->percentile(0.990)).count(),
-			   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_packet->percentile(0.950)).count(),
-			   _profiler_packet->count());
-#endif
+	// Profiling. The profilers are shared by every AV1 encoder, so these are the timings of all of them since the
+	// plugin was loaded, not just of this one.
+	if (_profiler_encode->count() > 0) {
+		D_LOG_INFO("Timings of all AV1 encoders since load:", "");
+		D_LOG_INFO("Timings | Avg. µs       | 99.9ile µs    | 99.0ile µs    | 95.0ile µs    | Samples  ", "");
+		D_LOG_INFO("--------+---------------+---------------+---------------+---------------+----------", "");
+		D_LOG_INFO("Copy    | %13.1f | %13" PRId64 " | %13" PRId64 " | %13" PRId64 " | %9" PRIu64,
+				   _profiler_copy->average_duration() / 1000.,
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_copy->percentile(0.999)).count(),
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_copy->percentile(0.990)).count(),
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_copy->percentile(0.950)).count(),
+				   _profiler_copy->count());
+		D_LOG_INFO("Encode  | %13.1f | %13" PRId64 " | %13" PRId64 " | %13" PRId64 " | %9" PRIu64,
+				   _profiler_encode->average_duration() / 1000.,
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_encode->percentile(0.999)).count(),
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_encode->percentile(0.990)).count(),
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_encode->percentile(0.950)).count(),
+				   _profiler_encode->count());
+		D_LOG_INFO("Packet  | %13.1f | %13" PRId64 " | %13" PRId64 " | %13" PRId64 " | %9" PRIu64,
+				   _profiler_packet->average_duration() / 1000.,
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_packet->percentile(0.999)).count(),
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_packet->percentile(0.990)).count(),
+				   std::chrono::duration_cast<std::chrono::microseconds>(_profiler_packet->percentile(0.950)).count(),
+				   _profiler_packet->count());
+	}
 
 	// Deallocate global buffer.
 	if (_global_headers) {
@@ -627,6 +613,44 @@ aom_av1_instance::~aom_av1_instance()
 		*/
 	}
 
+	// Stop chunked encoding. OBS keeps encoding until every output received a packet past its stop time, and packets
+	// leave in order, so the frames that are still in the chunks were all submitted after the outputs stopped.
+	{
+		std::unique_lock<std::mutex> lock(_chunk_lock);
+		_chunk_stop = true;
+
+		std::size_t lost = 0;
+		for (auto& chunk : _chunks) {
+			lost += chunk->length - chunk->delivered;
+		}
+		if (lost > 0) {
+			D_LOG_INFO("Discarded %zu frames submitted after the outputs stopped.", lost);
+		}
+	}
+	_chunk_submitted.notify_all();
+	_chunk_completed.notify_all();
+	for (auto& chunk : _chunks) {
+		if (chunk->worker.joinable()) {
+			chunk->worker.join();
+		}
+		while (!chunk->frames.empty()) {
+			_chunk_images.push(chunk->frames.front().first);
+			chunk->frames.pop();
+		}
+	}
+	_chunks.clear();
+	while (!_chunk_images.empty()) {
+		_factory->libaom_img_free(_chunk_images.top());
+		delete _chunk_images.top();
+		_chunk_images.pop();
+	}
+
+	// Packets leave in order and one per frame, so anything still queued was encoded after the outputs stopped. What
+	// libaom still holds in its look-ahead belongs to those frames as well, so it is not worth finishing.
+	if (!_packets.empty()) {
+		D_LOG_DEBUG("Discarded %zu packets encoded after the outputs stopped.", _packets.size());
+	}
+
 	// Deallocate frames.
 	for (auto& image : _images) {
 		_factory->libaom_img_free(&image);
@@ -655,7 +679,8 @@ bool aom_av1_instance::update(obs_data_t* settings)
 	{ // Generate Dynamic Settings
 
 		{ // Encoder
-			_settings.preset = static_cast<int8_t>(obs_data_get_int(settings, ST_KEY_ENCODER_CPUUSAGE));
+			_settings.preset          = static_cast<int8_t>(obs_data_get_int(settings, ST_KEY_ENCODER_CPUUSAGE));
+			_settings.preset_adaptive = obs_data_get_bool(settings, ST_KEY_ENCODER_CPUUSAGE_ADAPTIVE);
 		}
 
 		{ // Rate Control
@@ -717,9 +742,9 @@ bool aom_av1_instance::update(obs_data_t* settings)
 			_cfg.g_timebase.num = _settings.fps.den;
 			_cfg.g_timebase.den = _settings.fps.num;
 
-			// !INFO: Whenever OBS decides to support anything but 8-bits, let me know.
-			_cfg.g_bit_depth       = AOM_BITS_8;
-			_cfg.g_input_bit_depth = AOM_BITS_8;
+			// Bit Depth
+			_cfg.g_bit_depth       = static_cast<aom_bit_depth_t>(_settings.bit_depth);
+			_cfg.g_input_bit_depth = _settings.bit_depth;
 
 			// Monochrome color
 			_cfg.monochrome = _settings.monochrome ? 1 : 0;
@@ -804,140 +829,275 @@ bool aom_av1_instance::update(obs_data_t* settings)
 		}
 	}
 
+	{ // Adaptive Speed
+		// Only usages that encode at a fixed speed can be adjusted, and only if there is a speed to start from.
+		_speed.enabled = _settings.preset_adaptive && (_settings.preset != -1)
+						 && ((_cfg.g_usage == AOM_USAGE_REALTIME) || (_cfg.g_usage == AOM_USAGE_GOOD_QUALITY));
+		_speed.minimum  = _settings.preset;
+		_speed.maximum  = (_cfg.g_usage == AOM_USAGE_REALTIME) ? 10 : 9;
+		_speed.current  = _settings.preset;
+		_speed.load     = 0.;
+		_speed.budget   = static_cast<uint64_t>(_settings.fps.den) * 1000000000ull / _settings.fps.num;
+		_speed.cooldown = (_settings.fps.num + _settings.fps.den - 1) / _settings.fps.den;
+		if (_settings.preset_adaptive && !_speed.enabled) {
+			D_LOG_WARNING("Adaptive CPU Usage needs an explicit CPU Usage and a fixed speed usage, ignoring.", "");
+		}
+	}
+
 	if (_ctx.iface) { // Control
+		apply_dynamic_controls(&_ctx);
+	}
 
-		{ // Encoder
+#undef SET_IF_NOT_DEFAULT
+
+	// Log the changed settings.
+	if (_initialized) {
+		log();
+	}
+
+	return true;
+}
+
+void aom_av1_instance::automatic_layout(unsigned int usage, std::size_t cores)
+{
+	uint32_t size = (usage == AOM_USAGE_GOOD_QUALITY) ? ST_LAYOUT_TILE_SIZE_QUALITY : ST_LAYOUT_TILE_SIZE_REALTIME;
+	codec::av1::layout layout = {_settings.threads, _settings.rowmultithreading, _settings.tile_columns,
+								 _settings.tile_rows};
+	codec::av1::automatic_layout(layout, _settings.width, _settings.height, size, cores);
+	_settings.threads           = layout.threads;
+	_settings.rowmultithreading = layout.rowmultithreading;
+	_settings.tile_columns      = layout.tile_columns;
+	_settings.tile_rows         = layout.tile_rows;
+}
+
+void aom_av1_instance::apply_static_controls(aom_codec_ctx_t* ctx)
+{
+	{ // Color Information
+#ifdef AOM_CTRL_AV1E_SET_COLOR_PRIMARIES
+		if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_COLOR_PRIMARIES, _settings.color_primaries);
+			error != AOM_CODEC_OK) {
+			const char* errstr = _factory->libaom_codec_err_to_string(error);
+			const char* err    = _factory->libaom_codec_error(ctx);
+			const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+			D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+						  "AV1E_SET_COLOR_PRIMARIES",                             //
+						  (errstr ? errstr : ""), error,                          //
+						  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+						  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+			);
+		}
+#else
+		D_LOG_ERROR("AOM library was built without AV1E_SET_COLOR_PRIMARIES, behavior is unknown.");
+#endif
+
+#ifdef AOM_CTRL_AV1E_SET_TRANSFER_CHARACTERISTICS
+		if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_TRANSFER_CHARACTERISTICS, _settings.color_trc);
+			error != AOM_CODEC_OK) {
+			const char* errstr = _factory->libaom_codec_err_to_string(error);
+			const char* err    = _factory->libaom_codec_error(ctx);
+			const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+			D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+						  "AV1E_SET_TRANSFER_CHARACTERISTICS",                    //
+						  (errstr ? errstr : ""), error,                          //
+						  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+						  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+			);
+		}
+#else
+		D_LOG_ERROR("AOM library was built without AV1E_SET_TRANSFER_CHARACTERISTICS, behavior is unknown.");
+#endif
+
+#ifdef AOM_CTRL_AV1E_SET_MATRIX_COEFFICIENTS
+		if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_MATRIX_COEFFICIENTS, _settings.color_matrix);
+			error != AOM_CODEC_OK) {
+			const char* errstr = _factory->libaom_codec_err_to_string(error);
+			const char* err    = _factory->libaom_codec_error(ctx);
+			const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+			D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+						  "AV1E_SET_MATRIX_COEFFICIENTS",                         //
+						  (errstr ? errstr : ""), error,                          //
+						  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+						  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+			);
+		}
+#else
+		D_LOG_ERROR("AOM library was built without AV1E_SET_MATRIX_COEFFICIENTS, behavior is unknown.");
+#endif
+
+#ifdef AOM_CTRL_AV1E_SET_COLOR_RANGE
+		if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_COLOR_RANGE, _settings.color_range);
+			error != AOM_CODEC_OK) {
+			const char* errstr = _factory->libaom_codec_err_to_string(error);
+			const char* err    = _factory->libaom_codec_error(ctx);
+			const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+			D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+						  "AV1E_SET_COLOR_RANGE",                                 //
+						  (errstr ? errstr : ""), error,                          //
+						  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+						  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+			);
+		}
+#else
+		D_LOG_ERROR("AOM library was built without AV1_SET_COLOR_RANGE, behavior is unknown.");
+#endif
+
+#ifdef AOM_CTRL_AV1E_SET_CHROMA_SAMPLE_POSITION
+		// !TODO: Consider making this user-controlled. At the moment, this follows the H.264 chroma standard.
+		if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_CHROMA_SAMPLE_POSITION, AOM_CSP_VERTICAL);
+			error != AOM_CODEC_OK) {
+			const char* errstr = _factory->libaom_codec_err_to_string(error);
+			const char* err    = _factory->libaom_codec_error(ctx);
+			const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+			D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+						  "AV1E_SET_CHROMA_SAMPLE_POSITION",                      //
+						  (errstr ? errstr : ""), error,                          //
+						  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+						  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+			);
+		}
+#endif
+
+#ifdef AOM_CTRL_AV1E_SET_RENDER_SIZE
+		int32_t size[2] = {_settings.width, _settings.height};
+		if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_RENDER_SIZE, &size); error != AOM_CODEC_OK) {
+			const char* errstr = _factory->libaom_codec_err_to_string(error);
+			const char* err    = _factory->libaom_codec_error(ctx);
+			const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+			D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+						  "AV1E_SET_RENDER_SIZE",                                 //
+						  (errstr ? errstr : ""), error,                          //
+						  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+						  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+			);
+		}
+#endif
+	}
+}
+
+void aom_av1_instance::apply_dynamic_controls(aom_codec_ctx_t* ctx)
+{
+	{ // Encoder
 #ifdef AOM_CTRL_AOME_SET_CPUUSED
-			if (_settings.preset != -1) {
-				if (auto error = _factory->libaom_codec_control(&_ctx, AOME_SET_CPUUSED, _settings.preset);
-					error != AOM_CODEC_OK) {
-					const char* errstr = _factory->libaom_codec_err_to_string(error);
-					const char* err    = _factory->libaom_codec_error(&_ctx);
-					const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-					D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-								  "AOME_SET_CPUUSED",                                     //
-								  (errstr ? errstr : ""), error,                          //
-								  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-								  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-					);
-				}
+		if (_settings.preset != -1) {
+			if (auto error = _factory->libaom_codec_control(ctx, AOME_SET_CPUUSED, _settings.preset);
+				error != AOM_CODEC_OK) {
+				const char* errstr = _factory->libaom_codec_err_to_string(error);
+				const char* err    = _factory->libaom_codec_error(ctx);
+				const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+							  "AOME_SET_CPUUSED",                                     //
+							  (errstr ? errstr : ""), error,                          //
+							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+				);
 			}
-#endif
 		}
+#endif
+	}
 
-		{ // Rate Control
+	{ // Rate Control
 #ifdef AOM_CTRL_AOME_SET_CQ_LEVEL
-			if ((_settings.rc_quality != -1) && ((_settings.rc_mode == AOM_CQ) || (_settings.rc_mode == AOM_Q))) {
-				if (auto error = _factory->libaom_codec_control(&_ctx, AOME_SET_CQ_LEVEL, _settings.rc_quality);
-					error != AOM_CODEC_OK) {
-					const char* errstr = _factory->libaom_codec_err_to_string(error);
-					const char* err    = _factory->libaom_codec_error(&_ctx);
-					const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-					D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-								  "AOME_SET_CQ_LEVEL",                                    //
-								  (errstr ? errstr : ""), error,                          //
-								  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-								  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-					);
-				}
+		if ((_settings.rc_quality != -1) && ((_settings.rc_mode == AOM_CQ) || (_settings.rc_mode == AOM_Q))) {
+			if (auto error = _factory->libaom_codec_control(ctx, AOME_SET_CQ_LEVEL, _settings.rc_quality);
+				error != AOM_CODEC_OK) {
+				const char* errstr = _factory->libaom_codec_err_to_string(error);
+				const char* err    = _factory->libaom_codec_error(ctx);
+				const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+							  "AOME_SET_CQ_LEVEL",                                    //
+							  (errstr ? errstr : ""), error,                          //
+							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+				);
 			}
-#endif
 		}
+#endif
+	}
 
-		{ // Advanced
+	{ // Advanced
 #ifdef AOM_CTRL_AV1E_SET_ROW_MT
-			if (_settings.rowmultithreading != -1) {
-				if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_ROW_MT, _settings.rowmultithreading);
-					error != AOM_CODEC_OK) {
-					const char* errstr = _factory->libaom_codec_err_to_string(error);
-					const char* err    = _factory->libaom_codec_error(&_ctx);
-					const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-					D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-								  "AV1E_SET_ROW_MT",                                      //
-								  (errstr ? errstr : ""), error,                          //
-								  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-								  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-					);
-				}
+		if (_settings.rowmultithreading != -1) {
+			if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_ROW_MT, _settings.rowmultithreading);
+				error != AOM_CODEC_OK) {
+				const char* errstr = _factory->libaom_codec_err_to_string(error);
+				const char* err    = _factory->libaom_codec_error(ctx);
+				const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+							  "AV1E_SET_ROW_MT",                                      //
+							  (errstr ? errstr : ""), error,                          //
+							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+				);
 			}
+		}
 #endif
 
 #ifdef AOM_CTRL_AV1E_SET_TILE_COLUMNS
-			if (_settings.tile_columns != -1) {
-				if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_TILE_COLUMNS, _settings.tile_columns);
-					error != AOM_CODEC_OK) {
-					const char* errstr = _factory->libaom_codec_err_to_string(error);
-					const char* err    = _factory->libaom_codec_error(&_ctx);
-					const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-					D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-								  "AV1E_SET_TILE_COLUMNS",                                //
-								  (errstr ? errstr : ""), error,                          //
-								  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-								  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-					);
-				}
+		if (_settings.tile_columns != -1) {
+			if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_TILE_COLUMNS, _settings.tile_columns);
+				error != AOM_CODEC_OK) {
+				const char* errstr = _factory->libaom_codec_err_to_string(error);
+				const char* err    = _factory->libaom_codec_error(ctx);
+				const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+							  "AV1E_SET_TILE_COLUMNS",                                //
+							  (errstr ? errstr : ""), error,                          //
+							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+				);
 			}
+		}
 #endif
 
 #ifdef AOM_CTRL_AV1E_SET_TILE_ROWS
-			if (_settings.tile_rows != -1) {
-				if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_TILE_ROWS, _settings.tile_rows);
-					error != AOM_CODEC_OK) {
-					const char* errstr = _factory->libaom_codec_err_to_string(error);
-					const char* err    = _factory->libaom_codec_error(&_ctx);
-					const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-					D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-								  "AV1E_SET_TILE_ROWS",                                   //
-								  (errstr ? errstr : ""), error,                          //
-								  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-								  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-					);
-				}
+		if (_settings.tile_rows != -1) {
+			if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_TILE_ROWS, _settings.tile_rows);
+				error != AOM_CODEC_OK) {
+				const char* errstr = _factory->libaom_codec_err_to_string(error);
+				const char* err    = _factory->libaom_codec_error(ctx);
+				const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+							  "AV1E_SET_TILE_ROWS",                                   //
+							  (errstr ? errstr : ""), error,                          //
+							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+				);
 			}
+		}
 #endif
 #ifdef AOM_CTRL_AOME_SET_TUNING
-			if (_settings.tune_metric != -1) {
-				if (auto error = _factory->libaom_codec_control(&_ctx, AOME_SET_TUNING, _settings.tune_metric);
-					error != AOM_CODEC_OK) {
-					const char* errstr = _factory->libaom_codec_err_to_string(error);
-					const char* err    = _factory->libaom_codec_error(&_ctx);
-					const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-					D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-								  "AOME_SET_TUNING",                                      //
-								  (errstr ? errstr : ""), error,                          //
-								  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-								  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-					);
-				}
+		if (_settings.tune_metric != -1) {
+			if (auto error = _factory->libaom_codec_control(ctx, AOME_SET_TUNING, _settings.tune_metric);
+				error != AOM_CODEC_OK) {
+				const char* errstr = _factory->libaom_codec_err_to_string(error);
+				const char* err    = _factory->libaom_codec_error(ctx);
+				const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+							  "AOME_SET_TUNING",                                      //
+							  (errstr ? errstr : ""), error,                          //
+							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+				);
 			}
+		}
 #endif
 #ifdef AOM_CTRL_AV1E_SET_TUNE_CONTENT
-			if (_settings.tune_content != AOM_CONTENT_DEFAULT) {
-				if (auto error = _factory->libaom_codec_control(&_ctx, AV1E_SET_TUNE_CONTENT, _settings.tune_content);
-					error != AOM_CODEC_OK) {
-					const char* errstr = _factory->libaom_codec_err_to_string(error);
-					const char* err    = _factory->libaom_codec_error(&_ctx);
-					const char* errdtl = _factory->libaom_codec_error_detail(&_ctx);
-					D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
-								  "AV1E_SET_TUNE_CONTENT",                                //
-								  (errstr ? errstr : ""), error,                          //
-								  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
-								  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
-					);
-				}
+		if (_settings.tune_content != AOM_CONTENT_DEFAULT) {
+			if (auto error = _factory->libaom_codec_control(ctx, AV1E_SET_TUNE_CONTENT, _settings.tune_content);
+				error != AOM_CODEC_OK) {
+				const char* errstr = _factory->libaom_codec_err_to_string(error);
+				const char* err    = _factory->libaom_codec_error(ctx);
+				const char* errdtl = _factory->libaom_codec_error_detail(ctx);
+				D_LOG_WARNING("Error changing '%s': %s (code %" PRIu32 ")%s%s%s%s",   //
+							  "AV1E_SET_TUNE_CONTENT",                                //
+							  (errstr ? errstr : ""), error,                          //
+							  (err ? "\n\tMessage: " : ""), (err ? err : ""),         //
+							  (errdtl ? "\n\tDetails: " : ""), (errdtl ? errdtl : "") //
+				);
 			}
-#endif
 		}
+#endif
 	}
-
-#undef SET_IF_NOT_DEFAULT
-
-	// Log the changed settings.
-	if (_initialized) {
-		log();
-	}
-
-	return true;
 }
 
 void aom_av1_instance::log()
@@ -946,11 +1106,19 @@ void aom_av1_instance::log()
 	D_LOG_INFO("  Video: %" PRIu16 "x%" PRIu16 "@%1.2ffps (%" PRIu32 "/%" PRIu32 ")", _settings.width, _settings.height,
 			   static_cast<double>(_settings.fps.num) / static_cast<float>(_settings.fps.den), _settings.fps.num,
 			   _settings.fps.den);
-	D_LOG_INFO("  Color: %s/%s/%s%s", aom_color_format_to_string(_settings.color_format),
+	D_LOG_INFO("  Color: %s/%" PRIu8 "-bit/%s/%s%s", aom_color_format_to_string(_settings.color_format),
+			   _settings.bit_depth,
 			   aom_color_trc_to_string(_settings.color_trc),
 			   _settings.color_range == AOM_CR_FULL_RANGE ? "Full" : "Partial",
 			   _settings.monochrome ? "/Monochrome" : "");
 
+	// Encoder
+	if (_speed.enabled) {
+		D_LOG_INFO("  CPU Usage: %" PRId8 " - %" PRId8 " (Adaptive)", _speed.minimum, _speed.maximum);
+	} else {
+		D_LOG_INFO("  CPU Usage: %" PRId8, _settings.preset);
+	}
+
 	// Rate Control
 	D_LOG_INFO("  Rate Control: %s", aom_rc_mode_to_string(_settings.rc_mode));
 	D_LOG_INFO("    Look-Ahead: %" PRId8, _settings.rc_lookahead);
@@ -967,11 +1135,18 @@ void aom_av1_instance::log()
 
 	// Advanced
 	D_LOG_INFO("  Advanced: ", "");
+	D_LOG_INFO("   Layout: %s", _settings.layout_automatic ? "Automatic" : "Manual");
 	D_LOG_INFO("   Threads: %" PRId8, _settings.threads);
 	D_LOG_INFO("   Row-Multi-Threading: %s", _settings.rowmultithreading == -1  ? "Default"
 											 : _settings.rowmultithreading == 1 ? "Enabled"
 																				: "Disabled");
 	D_LOG_INFO("   Tiling: %" PRId8 "x%" PRId8, _settings.tile_columns, _settings.tile_rows);
+	if (_chunk_count > 0) {
+		D_LOG_INFO("   Chunks: %zu of %zu frames, at most %zu frames queued and %zu frames delay", _chunk_count,
+				   _chunk_length, _chunk_images_limit, _chunk_depth);
+	} else {
+		D_LOG_INFO("   Chunks: Disabled", "");
+	}
 	D_LOG_INFO("   Tune: %s (Metric), %s (Content)", aom_tune_metric_to_string(_settings.tune_metric),
 			   aom_tune_content_to_string(_settings.tune_content));
 }
@@ -1006,6 +1181,10 @@ void aom_av1_instance::get_video_info(struct video_scale_info* info)
 	case VIDEO_FORMAT_I444: // AOM_IMG_I444.
 	case VIDEO_FORMAT_I422: // AOM_IMG_I422.
 	case VIDEO_FORMAT_I420: // AOM_IMG_I420.
+#ifdef ST_HIGH_BIT_DEPTH
+	case VIDEO_FORMAT_I010: // AOM_IMG_I42016.
+	case VIDEO_FORMAT_P010: // AOM_IMG_I42016, after splitting U and V.
+#endif
 		break;
 
 		// 4:2:0 formats
@@ -1051,108 +1230,81 @@ void aom_av1_instance::get_video_info(struct video_scale_info* info)
 bool streamfx::encoder::aom::av1::aom_av1_instance::encode_video(encoder_frame* frame, encoder_packet* packet,
 																 bool* received_packet)
 {
+	if (_chunk_count > 0) {
+		return encode_chunked(frame, packet, received_packet);
+	}
+
 	// Retrieve current indexed image.
-	auto& image = _images.at(_image_index);
+	auto&        image = _images.at(_image_index);
+	aom_image_t* input = &image;
+
+	// libaom copies every image into its own lookahead buffer before returning from encode, so the planes that OBS
+	// gave us can be handed over directly, as long as they describe a complete image.
+	bool        can_wrap = !_settings.chroma_interleaved;
+	std::size_t sample   = (image.fmt & AOM_IMG_FMT_HIGHBITDEPTH) ? 2 : 1;
+	for (std::size_t idx = AOM_PLANE_Y; idx <= AOM_PLANE_V; idx++) {
+		std::size_t width = image.d_w;
+		if (idx != AOM_PLANE_Y) {
+			width = (width + image.x_chroma_shift) >> image.x_chroma_shift;
+		}
+		if (!frame->data[idx] || (frame->linesize[idx] < (width * sample))) {
+			can_wrap = false;
+		}
+	}
 
-	{ // Copy Image data.
-#ifdef ENABLE_PROFILING
-		auto profile = _profiler_copy->track();
-#endif
-		std::memcpy(image.planes[AOM_PLANE_Y], frame->data[0], frame->linesize[0] * image.h);
-		if (image.fmt == AOM_IMG_FMT_I420) {
-			std::memcpy(image.planes[AOM_PLANE_U], frame->data[1], frame->linesize[1] * image.h / 2);
-			std::memcpy(image.planes[AOM_PLANE_V], frame->data[2], frame->linesize[2] * image.h / 2);
-		} else {
-			std::memcpy(image.planes[AOM_PLANE_U], frame->data[1], frame->linesize[1] * image.h);
-			std::memcpy(image.planes[AOM_PLANE_V], frame->data[2], frame->linesize[2] * image.h);
+	aom_image_t wrapped;
+	if (can_wrap
+		&& _factory->libaom_img_wrap(&wrapped, image.fmt, image.d_w, image.d_h, 1, frame->data[AOM_PLANE_Y])) {
+		for (std::size_t idx = AOM_PLANE_Y; idx <= AOM_PLANE_V; idx++) {
+			wrapped.planes[idx] = frame->data[idx];
+			wrapped.stride[idx] = static_cast<int>(frame->linesize[idx]);
 		}
+
+		// Color Information.
+		wrapped.cp         = image.cp;
+		wrapped.tc         = image.tc;
+		wrapped.mc         = image.mc;
+		wrapped.range      = image.range;
+		wrapped.monochrome = image.monochrome;
+		wrapped.csp        = image.csp;
+		wrapped.bit_depth  = image.bit_depth;
+
+		input = &wrapped;
+	} else { // Copy Image data.
+		auto profile = _profiler_copy->track();
+		copy_image(frame, image);
 	}
 
 	{ // Try to encode the new image.
-#ifdef ENABLE_PROFILING
 		auto profile = _profiler_encode->track();
-#endif
 		aom_enc_frame_flags_t flags = 0;
 		if (_cfg.g_usage == AOM_USAGE_ALL_INTRA) {
 			flags = AOM_EFLAG_FORCE_KF;
 		}
-		if (auto error = _factory->libaom_codec_encode(&_ctx, &image, frame->pts, 1, flags); error != AOM_CODEC_OK) {
+
+		auto started = std::chrono::high_resolution_clock::now();
+		if (auto error = _factory->libaom_codec_encode(&_ctx, input, frame->pts, 1, flags); error != AOM_CODEC_OK) {
 			const char* errstr = _factory->libaom_codec_err_to_string(error);
 			D_LOG_ERROR("Encoding frame failed with error: %s (code %" PRIu32 ")\n%s\n%s", errstr, error,
 						_factory->libaom_codec_error(&_ctx), _factory->libaom_codec_error_detail(&_ctx));
 			return false;
 		} else {
 			// Increment the image index.
-			_image_index = (_image_index++) % _images.size();
+			_image_index = (_image_index + 1) % _images.size();
+		}
+
+		if (_speed.enabled) {
+			adapt_speed(std::chrono::high_resolution_clock::now() - started);
 		}
 	}
 
-	{ // Get Packet
-#ifdef ENABLE_PROFILING
+	{ // Get Packets
 		auto profile = _profiler_packet->track();
-#endif
-		aom_codec_iter_t iter = NULL;
-		for (auto* pkt = _factory->libaom_codec_get_cx_data(&_ctx, &iter); pkt != nullptr;
-			 pkt       = _factory->libaom_codec_get_cx_data(&_ctx, &iter)) {
-#ifdef _DEBUG
-			{
-				const char* kind = "";
-				switch (pkt->kind) {
-				case AOM_CODEC_CX_FRAME_PKT:
-					kind = "Frame";
-					break;
-				case AOM_CODEC_STATS_PKT:
-					kind = "Stats";
-					break;
-				case AOM_CODEC_FPMB_STATS_PKT:
-					kind = "FPMB Stats";
-					break;
-				case AOM_CODEC_PSNR_PKT:
-					kind = "PSNR";
-					break;
-				case AOM_CODEC_CUSTOM_PKT:
-					kind = "Custom";
-					break;
-				}
-				D_LOG_DEBUG("\tPacket: Kind=%s", kind)
-			}
-#endif
-
-			if (pkt->kind == AOM_CODEC_CX_FRAME_PKT) {
-				// Status
-				packet->type     = OBS_ENCODER_VIDEO;
-				packet->keyframe = ((pkt->data.frame.flags & AOM_FRAME_IS_KEY) == AOM_FRAME_IS_KEY)
-								   || (_cfg.g_usage == AOM_USAGE_ALL_INTRA);
-				if (packet->keyframe) {
-					//
-					packet->priority      = 0;
-					packet->drop_priority = packet->priority;
-				} else if ((pkt->data.frame.flags & AOM_FRAME_IS_DROPPABLE) != AOM_FRAME_IS_DROPPABLE) {
-					// Dropping this frame breaks the bitstream.
-					packet->priority      = -1;
-					packet->drop_priority = packet->priority;
-				} else {
-					// This frame can be dropped at will.
-					packet->priority      = -2;
-					packet->drop_priority = packet->priority;
-				}
-
-				// Data
-				packet->data = static_cast<uint8_t*>(pkt->data.frame.buf);
-				packet->size = pkt->data.frame.sz;
 
-				// Timestamps
-				//TODO: Temporarily set both to the same until there is a way to figure out actual order.
-				packet->pts = pkt->data.frame.pts;
-				packet->dts = pkt->data.frame.pts;
-
-				*received_packet = true;
-			}
-
-			if (*received_packet == true)
-				break;
-		}
+		// Take everything libaom produced, as the iterator does not remember packets between calls.
+		collect_packets(&_ctx, _packets);
 
+		*received_packet = pop_packet(_packets, packet);
 		if (!*received_packet) {
 			packet->type = OBS_ENCODER_VIDEO;
 			packet->data = nullptr;
@@ -1166,39 +1318,525 @@ bool streamfx::encoder::aom::av1::aom_av1_instance::encode_video(encoder_frame*
 			//return false;
 		} else {
 #ifdef _DEBUG
-			D_LOG_DEBUG("Packet: Type=%s PTS=%06" PRId64 " DTS=%06" PRId64 " Size=%016" PRIuPTR "",
-						packet->keyframe ? "I" : "P", packet->pts, packet->dts, packet->size);
+			D_LOG_DEBUG("Packet: Type=%s PTS=%06" PRId64 " DTS=%06" PRId64 " Size=%016" PRIuPTR " Queued=%zu",
+						packet->keyframe ? "I" : "P", packet->pts, packet->dts, packet->size, _packets.size());
+#endif
+		}
+	}
+
+	return true;
+}
+
+void aom_av1_instance::prepare_image(aom_image_t& image)
+{
+	_factory->libaom_img_alloc(&image, _settings.color_format, _settings.width, _settings.height, 8);
+
+	// Color Information.
+	image.fmt        = _settings.color_format;
+	image.cp         = _settings.color_primaries;
+	image.tc         = _settings.color_trc;
+	image.mc         = _settings.color_matrix;
+	image.range      = _settings.color_range;
+	image.monochrome = _settings.monochrome ? 1 : 0;
+	image.csp        = AOM_CSP_VERTICAL; // !TODO: Consider making this user-controlled.
+	image.bit_depth  = _settings.bit_depth;
+
+	// Size
+	image.r_w = image.d_w;
+	image.r_h = image.d_h;
+	image.r_w = image.w;
+	image.r_h = image.h;
+}
+
+void aom_av1_instance::copy_image(encoder_frame* frame, aom_image_t& image)
+{
+	if (_settings.chroma_interleaved) {
+		// P010 keeps its samples in the upper bits, and U and V interleaved in one plane, while libaom wants them in
+		// the lower bits and in separate planes.
+		uint8_t     shift     = static_cast<uint8_t>(16 - _settings.bit_depth);
+		std::size_t width     = image.d_w;
+		std::size_t chroma_w  = (image.d_w + image.x_chroma_shift) >> image.x_chroma_shift;
+		std::size_t chroma_h  = (image.d_h + image.y_chroma_shift) >> image.y_chroma_shift;
+		std::size_t ls_in_y   = static_cast<size_t>(frame->linesize[0]);
+		std::size_t ls_in_uv  = static_cast<size_t>(frame->linesize[1]);
+		std::size_t ls_out_y  = static_cast<size_t>(image.stride[AOM_PLANE_Y]);
+		std::size_t ls_out_uv = static_cast<size_t>(image.stride[AOM_PLANE_U]);
+		uint8_t*    from_y    = frame->data[0];
+		uint8_t*    from_uv   = frame->data[1];
+		uint8_t*    to_y      = image.planes[AOM_PLANE_Y];
+		uint8_t*    to_u      = image.planes[AOM_PLANE_U];
+		uint8_t*    to_v      = image.planes[AOM_PLANE_V];
+
+		streamfx::threadpool()->parallel_for(
+			0, image.d_h, ST_COPY_ROWS_PER_TASK, [&](std::size_t begin, std::size_t end) {
+				for (std::size_t y = begin; y < end; y++) {
+					streamfx::util::shift_row16(reinterpret_cast<uint16_t*>(to_y + ls_out_y * y),
+												reinterpret_cast<const uint16_t*>(from_y + ls_in_y * y), width, shift);
+				}
+			});
+		streamfx::threadpool()->parallel_for(
+			0, chroma_h, ST_COPY_ROWS_PER_TASK, [&](std::size_t begin, std::size_t end) {
+				for (std::size_t y = begin; y < end; y++) {
+					streamfx::util::deinterleave_row16(reinterpret_cast<uint16_t*>(to_u + ls_out_uv * y),
+													   reinterpret_cast<uint16_t*>(to_v + ls_out_uv * y),
+													   reinterpret_cast<const uint16_t*>(from_uv + ls_in_uv * y),
+													   chroma_w, shift);
+				}
+			});
+		return;
+	}
+
+	for (std::size_t idx = AOM_PLANE_Y; idx <= AOM_PLANE_V; idx++) {
+		std::size_t height = image.h;
+		if (idx != AOM_PLANE_Y) {
+			height = (height + image.y_chroma_shift) >> image.y_chroma_shift;
+		}
+
+		std::size_t ls_in  = static_cast<size_t>(frame->linesize[idx]);
+		std::size_t ls_out = static_cast<size_t>(image.stride[idx]);
+		std::size_t bytes  = std::min(ls_in, ls_out);
+		uint8_t*    to     = image.planes[idx];
+		uint8_t*    from   = frame->data[idx];
+
+		// Copy bands of rows in parallel, as a single thread can't saturate the available memory bandwidth.
+		streamfx::threadpool()->parallel_for(0, height, ST_COPY_ROWS_PER_TASK,
+											 [to, from, ls_in, ls_out, bytes](std::size_t begin, std::size_t end) {
+												 streamfx::util::copy_plane(to + ls_out * begin, ls_out,
+																			from + ls_in * begin, ls_in, bytes,
+																			end - begin);
+											 });
+	}
+}
+
+void aom_av1_instance::fill_packet(const aom_codec_cx_pkt_t* pkt, encoder_packet* packet)
+{
+	// Status
+	packet->type     = OBS_ENCODER_VIDEO;
+	packet->keyframe = ((pkt->data.frame.flags & AOM_FRAME_IS_KEY) == AOM_FRAME_IS_KEY)
+					   || (_cfg.g_usage == AOM_USAGE_ALL_INTRA);
+	if (packet->keyframe) {
+		//
+		packet->priority      = 0;
+		packet->drop_priority = packet->priority;
+	} else if ((pkt->data.frame.flags & AOM_FRAME_IS_DROPPABLE) != AOM_FRAME_IS_DROPPABLE) {
+		// Dropping this frame breaks the bitstream.
+		packet->priority      = -1;
+		packet->drop_priority = packet->priority;
+	} else {
+		// This frame can be dropped at will.
+		packet->priority      = -2;
+		packet->drop_priority = packet->priority;
+	}
+
+	// Data
+	packet->data = static_cast<uint8_t*>(pkt->data.frame.buf);
+	packet->size = pkt->data.frame.sz;
+
+	// Timestamps
+	//TODO: Temporarily set both to the same until there is a way to figure out actual order.
+	packet->pts = pkt->data.frame.pts;
+	packet->dts = pkt->data.frame.pts;
+}
+
+std::size_t aom_av1_instance::collect_packets(aom_codec_ctx_t* ctx, std::queue<queued_packet>& packets)
+{
+	std::size_t      count = 0;
+	aom_codec_iter_t iter  = NULL;
+	for (auto* pkt = _factory->libaom_codec_get_cx_data(ctx, &iter); pkt != nullptr;
+		 pkt       = _factory->libaom_codec_get_cx_data(ctx, &iter)) {
+#ifdef _DEBUG
+		{
+			const char* kind = "";
+			switch (pkt->kind) {
+			case AOM_CODEC_CX_FRAME_PKT:
+				kind = "Frame";
+				break;
+			case AOM_CODEC_STATS_PKT:
+				kind = "Stats";
+				break;
+			case AOM_CODEC_FPMB_STATS_PKT:
+				kind = "FPMB Stats";
+				break;
+			case AOM_CODEC_PSNR_PKT:
+				kind = "PSNR";
+				break;
+			case AOM_CODEC_CUSTOM_PKT:
+				kind = "Custom";
+				break;
+			}
+			D_LOG_DEBUG("\tPacket: Kind=%s", kind)
+		}
+#endif
+
+		if (pkt->kind != AOM_CODEC_CX_FRAME_PKT) {
+			continue;
+		}
+
+		// The packet data is only valid until the next call into libaom, so copy it into a recycled buffer.
+		queued_packet entry;
+		{
+			std::unique_lock<std::mutex> lock(_packet_buffers_lock);
+			if (!_packet_buffers.empty()) {
+				entry.data = std::move(_packet_buffers.top());
+				_packet_buffers.pop();
+			}
+		}
+		fill_packet(pkt, &entry.packet);
+		entry.data.assign(static_cast<const uint8_t*>(pkt->data.frame.buf),
+						  static_cast<const uint8_t*>(pkt->data.frame.buf) + pkt->data.frame.sz);
+
+		packets.push(std::move(entry));
+		count++;
+	}
+	return count;
+}
+
+bool aom_av1_instance::pop_packet(std::queue<queued_packet>& packets, encoder_packet* packet)
+{
+	if (packets.empty()) {
+		return false;
+	}
+
+	// Keep the packet data alive until the next call, as OBS only copies it later.
+	if (_packet.data.capacity() > 0) {
+		std::unique_lock<std::mutex> lock(_packet_buffers_lock);
+		_packet_buffers.push(std::move(_packet.data));
+	}
+	_packet = std::move(packets.front());
+	packets.pop();
+
+	*packet      = _packet.packet;
+	packet->data = _packet.data.data();
+	packet->size = _packet.data.size();
+	return true;
+}
+
+void aom_av1_instance::adapt_speed(std::chrono::nanoseconds duration)
+{
+	double load = static_cast<double>(duration.count()) / static_cast<double>(_speed.budget);
+	_speed.load += (load - _speed.load) * ST_SPEED_SMOOTHING;
+
+	// Give the encoder time to settle after every change.
+	if (_speed.cooldown > 0) {
+		_speed.cooldown--;
+		return;
+	}
+
+	int8_t speed = _speed.current;
+	if ((_speed.load > ST_SPEED_THRESHOLD_HIGH) && (speed < _speed.maximum)) {
+		speed++;
+	} else if ((_speed.load < ST_SPEED_THRESHOLD_LOW) && (speed > _speed.minimum)) {
+		speed--;
+	} else {
+		return;
+	}
+
+#ifdef AOM_CTRL_AOME_SET_CPUUSED
+	if (auto error = _factory->libaom_codec_control(&_ctx, AOME_SET_CPUUSED, speed); error != AOM_CODEC_OK) {
+		D_LOG_WARNING("Failed to change CPU usage to %" PRId8 ", disabling adaptive speed: %s (code %" PRIu32 ")",
+					  speed, _factory->libaom_codec_err_to_string(error), error);
+		_speed.enabled = false;
+		return;
+	}
 #endif
+	D_LOG_DEBUG("Encoding took %.0f%% of the frame time, changed CPU usage from %" PRId8 " to %" PRId8 ".",
+				_speed.load * 100., _speed.current, speed);
+
+	// Wait a second's worth of frames before the next change.
+	_speed.current  = speed;
+	_speed.cooldown = (_settings.fps.num + _settings.fps.den - 1) / _settings.fps.den;
+}
+
+bool aom_av1_instance::encode_chunked(encoder_frame* frame, encoder_packet* packet, bool* received_packet)
+{
+	// Chunks keep their images until they are encoded, so the frame has to be copied. Only a limited number of images
+	// exist, and once all of them are waiting to be encoded, wait for one of the chunks to finish a frame.
+	aom_image_t* image = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(_chunk_lock);
+		_chunk_completed.wait(lock, [this]() {
+			return _chunk_error || !_chunk_images.empty() || (_chunk_images_allocated < _chunk_images_limit);
+		});
+		if (_chunk_error) {
+			return false;
+		}
+
+		if (!_chunk_images.empty()) {
+			image = _chunk_images.top();
+			_chunk_images.pop();
+		} else {
+			_chunk_images_allocated++;
+		}
+	}
+	if (!image) {
+		image = new aom_image_t();
+		prepare_image(*image);
+	}
+	{
+		auto profile = _profiler_copy->track();
+		copy_image(frame, *image);
+	}
+
+	std::vector<std::shared_ptr<chunk>> finished;
+	{
+		std::unique_lock<std::mutex> lock(_chunk_lock);
+		if (_chunk_error) {
+			_chunk_images.push(image);
+			return false;
+		}
+
+		// Close the open chunk once it has a full group of pictures.
+		if (!_chunks.empty() && !_chunks.back()->closed && (_chunks.back()->length >= _chunk_length)) {
+			_chunks.back()->closed = true;
+			_chunk_submitted.notify_all();
+		}
+
+		// Start a new chunk. It only begins encoding once fewer than the requested number of chunks are ahead of it.
+		if (_chunks.empty() || _chunks.back()->closed) {
+			auto next       = std::make_shared<chunk>();
+			next->ctx       = {};
+			next->length    = 0;
+			next->delivered = 0;
+			next->closed    = false;
+			next->done      = false;
+
+			aom_codec_enc_cfg_t cfg = _cfg;
+
+			// Each chunk gets an equal share of the threads.
+			cfg.g_threads = std::max<unsigned int>(_cfg.g_threads / static_cast<unsigned int>(_chunk_count), 1);
+			aom_codec_flags_t flags = (_settings.bit_depth > 8) ? AOM_CODEC_USE_HIGHBITDEPTH : 0;
+			if (auto error =
+					_factory->libaom_codec_enc_init_ver(&next->ctx, _iface, &cfg, flags, AOM_ENCODER_ABI_VERSION);
+				error != AOM_CODEC_OK) {
+				D_LOG_ERROR("Failed to initialize chunk, unexpected error: %s (code %" PRIu32 ")",
+							_factory->libaom_codec_err_to_string(error), error);
+				_chunk_images.push(image);
+				return false;
+			}
+			apply_static_controls(&next->ctx);
+			apply_dynamic_controls(&next->ctx);
+
+			next->worker = std::thread(&aom_av1_instance::chunk_main, this, next);
+			_chunks.push_back(next);
+		}
+
+		// Hand the image to the open chunk.
+		_chunks.back()->frames.emplace(image, frame->pts);
+		_chunks.back()->length++;
+		_chunk_submitted.notify_all();
+
+		// OBS takes at most one packet per frame. Once more frames are in flight than the chunks can be working on,
+		// wait for the next packet, so that one leaves for every frame that arrives and the delay stops growing.
+		_chunk_completed.wait(lock, [this]() {
+			if (_chunk_error) {
+				return true;
+			}
+
+			// Chunks that are done and empty are skipped, the first one after them decides.
+			for (auto& v : _chunks) {
+				if (!v->packets.empty()) {
+					return true;
+				} else if (!v->done) {
+					break;
+				}
+			}
+
+			std::size_t pending = 0;
+			for (auto& v : _chunks) {
+				pending += v->length - v->delivered;
+			}
+			return pending < _chunk_depth;
+		});
+		if (_chunk_error) {
+			return false;
+		}
+
+		// Packets have to leave in order, so only the oldest chunk may hand them out.
+		auto profile = _profiler_packet->track();
+		while ((_chunks.size() > 1) && _chunks.front()->done && _chunks.front()->packets.empty()) {
+			finished.push_back(_chunks.front());
+			_chunks.pop_front();
+		}
+		auto front       = _chunks.front();
+		*received_packet = pop_packet(front->packets, packet);
+		if (*received_packet) {
+			front->delivered++;
+		}
+	}
+
+	// Joining may take a moment, so do it without holding the lock.
+	for (auto& chunk : finished) {
+		if (chunk->worker.joinable()) {
+			chunk->worker.join();
 		}
 	}
 
 	return true;
 }
 
-aom_av1_factory::aom_av1_factory()
+void aom_av1_instance::chunk_main(std::shared_ptr<chunk> chunk)
 {
-	// Try and load the AOM library.
-	std::vector<std::filesystem::path> libs;
+	bool failed = false;
+
+	auto collect = [this, &chunk]() {
+		std::queue<queued_packet> packets;
+		std::size_t               count = collect_packets(&chunk->ctx, packets);
+
+		{
+			std::unique_lock<std::mutex> lock(_chunk_lock);
+			for (; !packets.empty(); packets.pop()) {
+				chunk->packets.push(std::move(packets.front()));
+			}
+		}
+		if (count > 0) {
+			_chunk_completed.notify_all();
+		}
+		return count;
+	};
+
+	std::unique_lock<std::mutex> lock(_chunk_lock);
+
+	// Encode in the order the chunks were started, with no more than the requested number of chunks at once.
+	_chunk_submitted.wait(lock, [this, &chunk]() {
+		std::size_t ahead = 0;
+		for (auto& v : _chunks) {
+			if (v == chunk) {
+				break;
+			}
+			ahead += v->done ? 0 : 1;
+		}
+		return _chunk_stop || (ahead < _chunk_count);
+	});
+
+	while (!_chunk_stop) {
+		_chunk_submitted.wait(lock,
+							  [this, &chunk]() { return _chunk_stop || chunk->closed || !chunk->frames.empty(); });
+		if (_chunk_stop) {
+			break;
+		}
+
+		if (chunk->frames.empty()) { // Closed and all frames submitted, so flush the encoder.
+			lock.unlock();
+			do {
+				if (_factory->libaom_codec_encode(&chunk->ctx, nullptr, 0, 1, 0) != AOM_CODEC_OK) {
+					failed = true;
+					break;
+				}
+			} while (collect() > 0);
+			lock.lock();
+			break;
+		}
+
+		auto [image, pts] = chunk->frames.front();
+		chunk->frames.pop();
+		lock.unlock();
+
+		{
+			auto profile = _profiler_encode->track();
+			if (auto error = _factory->libaom_codec_encode(&chunk->ctx, image, pts, 1, 0); error != AOM_CODEC_OK) {
+				D_LOG_ERROR("Encoding frame failed with error: %s (code %" PRIu32 ")\n%s\n%s",
+							_factory->libaom_codec_err_to_string(error), error,
+							_factory->libaom_codec_error(&chunk->ctx),
+							_factory->libaom_codec_error_detail(&chunk->ctx));
+				failed = true;
+			}
+		}
+		if (!failed) {
+			collect();
+		}
+
+		lock.lock();
+		_chunk_images.push(image);
+		_chunk_completed.notify_all();
+		if (failed) {
+			break;
+		}
+	}
+
+	if (failed) {
+		_chunk_error = true;
+	}
+	chunk->done = true;
+	lock.unlock();
+	_chunk_completed.notify_all();
+	_chunk_submitted.notify_all(); // Lets the next chunk start encoding.
 
+	_factory->libaom_codec_destroy(&chunk->ctx);
+}
+
+aom_av1_factory::aom_av1_factory() : _library(), _library_paths(), _library_loaded()
+{
+	// Candidates for the AOM library, in order of preference.
 #ifdef D_PLATFORM_WINDOWS
 	// Try loading from the data directory first.
-	libs.push_back(streamfx::data_file_path("aom.dll"));    // MSVC (preferred)
-	libs.push_back(streamfx::data_file_path("libaom.dll")); // Cross-Compile
+	_library_paths.push_back(streamfx::data_file_path("aom.dll"));    // MSVC (preferred)
+	_library_paths.push_back(streamfx::data_file_path("libaom.dll")); // Cross-Compile
 	// In any other case, load the system-wide binary.
-	libs.push_back("aom.dll");
-	libs.push_back("libaom.dll");
+	_library_paths.push_back("aom.dll");
+	_library_paths.push_back("libaom.dll");
 #else
 	// Try loading from the data directory first.
-	libs.push_back(streamfx::data_file_path("libaom.so"));
+	_library_paths.push_back(streamfx::data_file_path("libaom.so"));
 	// In any other case, load the system-wide binary.
-	libs.push_back("libaom");
+	_library_paths.push_back("libaom");
 #endif
 
-	for (auto lib : libs) {
+	// Probe for the library without loading it, which is only possible for the ones we ship ourselves. A system-wide
+	// binary can only be found by the loader, so it is loaded here already, but its functions are still resolved later.
+	bool found = false;
+	for (auto lib : _library_paths) {
+		std::error_code ec;
+		if (lib.is_absolute() && std::filesystem::exists(lib, ec)) {
+			found = true;
+			break;
+		}
+	}
+	if (!found) {
+		for (auto lib : _library_paths) {
+			if (lib.is_absolute()) {
+				continue;
+			}
+
+			try {
+				_library = streamfx::util::library::load(lib);
+				if (_library)
+					break;
+			} catch (...) {
+				D_LOG_WARNING("Loading of '%s' failed.", lib.generic_string().c_str());
+			}
+		}
+		if (!_library) {
+			throw std::runtime_error("Unable to load AOM library.");
+		}
+	}
+
+	// Register encoder.
+	_info.id    = S_PREFIX "aom-av1";
+	_info.type  = obs_encoder_type::OBS_ENCODER_VIDEO;
+	_info.codec = "av1";
+	_info.caps  = OBS_ENCODER_CAP_DYN_BITRATE;
+
+	finish_setup();
+}
+
+aom_av1_factory::~aom_av1_factory() {}
+
+void aom_av1_factory::load()
+{
+	// If loading fails, the next caller tries again.
+	std::call_once(_library_loaded, &aom_av1_factory::load_library, this);
+}
+
+void aom_av1_factory::load_library()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (auto lib : _library_paths) {
+		if (_library)
+			break;
+
 		try {
 			_library = streamfx::util::library::load(lib);
-			if (_library)
-				break;
 		} catch (...) {
 			D_LOG_WARNING("Loading of '%s' failed.", lib.generic_string().c_str());
 		}
@@ -1258,17 +1896,15 @@ aom_av1_factory::aom_av1_factory()
 	_LOAD_SYMBOL(aom_codec_av1_cx);
 #undef _LOAD_SYMBOL
 
-	// Register encoder.
-	_info.id    = S_PREFIX "aom-av1";
-	_info.type  = obs_encoder_type::OBS_ENCODER_VIDEO;
-	_info.codec = "av1";
-	_info.caps  = OBS_ENCODER_CAP_DYN_BITRATE;
-
-	finish_setup();
+	D_LOG_INFO("Loaded libaom %s in %.3f ms.", libaom_codec_version_str(),
+			   std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+#ifndef ST_HIGH_BIT_DEPTH
+	D_LOG_INFO("10-bit and HDR encoding is unavailable, as it requires libOBS 28 or newer, but this was built against "
+			   "libOBS %d.",
+			   LIBOBS_API_MAJOR_VER);
+#endif
 }
 
-aom_av1_factory::~aom_av1_factory() {}
-
 std::shared_ptr<aom_av1_factory> _aom_av1_factory_instance = nullptr;
 
 void aom_av1_factory::initialize()
@@ -1297,6 +1933,7 @@ const char* aom_av1_factory::get_name()
 
 void* aom_av1_factory::create(obs_data_t* settings, obs_encoder_t* encoder, bool is_hw)
 {
+	load();
 	return new aom_av1_instance(settings, encoder, is_hw);
 }
 
@@ -1305,6 +1942,7 @@ void aom_av1_factory::get_defaults2(obs_data_t* settings)
 	{ // Presets
 		obs_data_set_default_int(settings, ST_KEY_ENCODER_USAGE, static_cast<long long>(AOM_USAGE_REALTIME));
 		obs_data_set_default_int(settings, ST_KEY_ENCODER_CPUUSAGE, -1);
+		obs_data_set_default_bool(settings, ST_KEY_ENCODER_CPUUSAGE_ADAPTIVE, false);
 		obs_data_set_default_int(settings, ST_KEY_ENCODER_PROFILE,
 								 static_cast<long long>(codec::av1::profile::UNKNOWN));
 	}
@@ -1339,6 +1977,7 @@ void aom_av1_factory::get_defaults2(obs_data_t* settings)
 		obs_data_set_default_int(settings, ST_KEY_ADVANCED_TILE_ROWS, -1);
 		obs_data_set_default_int(settings, ST_KEY_ADVANCED_TUNE_METRIC, -1);
 		obs_data_set_default_int(settings, ST_KEY_ADVANCED_TUNE_CONTENT, static_cast<long long>(AOM_CONTENT_DEFAULT));
+		obs_data_set_default_int(settings, ST_KEY_ADVANCED_CHUNKS, 0);
 	}
 }
 
@@ -1352,6 +1991,12 @@ try {
 	// All-Intra does not support these.
 	obs_property_set_visible(obs_properties_get(props, ST_KEY_RATECONTROL_LOOKAHEAD), !is_all_intra);
 	obs_property_set_visible(obs_properties_get(props, ST_I18N_KEYFRAMES), !is_all_intra);
+	obs_property_set_visible(obs_properties_get(props, ST_KEY_ADVANCED_CHUNKS), !is_all_intra);
+	obs_property_set_visible(obs_properties_get(props, ST_KEY_ENCODER_CPUUSAGE_ADAPTIVE), !is_all_intra);
+
+	// Adapting needs an explicit CPU Usage to start from.
+	obs_property_set_enabled(obs_properties_get(props, ST_KEY_ENCODER_CPUUSAGE_ADAPTIVE),
+							 obs_data_get_int(settings, ST_KEY_ENCODER_CPUUSAGE) != -1);
 
 	return true;
 } catch (const std::exception& ex) {
@@ -1423,6 +2068,13 @@ try {
 
 obs_properties_t* aom_av1_factory::get_properties2(instance_t* data)
 {
+	// The properties do not need the library, but whoever opens them is likely to use the encoder soon.
+	try {
+		load();
+	} catch (std::exception const& ex) {
+		D_LOG_WARNING("Failed to load AOM library: %s", ex.what());
+	}
+
 	obs_properties_t* props = obs_properties_create();
 
 #ifdef ENABLE_FRONTEND
@@ -1453,6 +2105,7 @@ obs_properties_t* aom_av1_factory::get_properties2(instance_t* data)
 		{ // CPU Usage
 			auto p = obs_properties_add_list(grp, ST_KEY_ENCODER_CPUUSAGE, D_TRANSLATE(ST_I18N_ENCODER_CPUUSAGE),
 											 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+			obs_property_set_modified_callback(p, modified_usage);
 			obs_property_list_add_int(p, D_TRANSLATE(S_STATE_DEFAULT), -1);
 			obs_property_list_add_int(p, D_TRANSLATE(ST_I18N_ENCODER_CPUUSAGE_10), 10);
 			obs_property_list_add_int(p, D_TRANSLATE(ST_I18N_ENCODER_CPUUSAGE_9), 9);
@@ -1466,6 +2119,11 @@ obs_properties_t* aom_av1_factory::get_properties2(instance_t* data)
 			obs_property_list_add_int(p, D_TRANSLATE(ST_I18N_ENCODER_CPUUSAGE_1), 1);
 			obs_property_list_add_int(p, D_TRANSLATE(ST_I18N_ENCODER_CPUUSAGE_0), 0);
 		}
+
+		{ // Adaptive CPU Usage
+			auto p = obs_properties_add_bool(grp, ST_KEY_ENCODER_CPUUSAGE_ADAPTIVE,
+											 D_TRANSLATE(ST_I18N_ENCODER_CPUUSAGE_ADAPTIVE));
+		}
 #endif
 
 		{ // Profile
@@ -1608,6 +2266,11 @@ obs_properties_t* aom_av1_factory::get_properties2(instance_t* data)
 											std::numeric_limits<int32_t>::max(), 1);
 		}
 
+		{ // Chunks
+			auto p = obs_properties_add_int(grp, ST_KEY_ADVANCED_CHUNKS, D_TRANSLATE(ST_I18N_ADVANCED_CHUNKS), 0,
+											std::numeric_limits<int8_t>::max(), 1);
+		}
+
 #ifdef AOM_CTRL_AV1E_SET_ROW_MT
 		{ // Row-MT
 			auto p = streamfx::util::obs_properties_add_tristate(grp, ST_KEY_ADVANCED_ROWMULTITHREADING,
@@ -20,8 +20,16 @@
 
 #pragma once
 #include "common.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <stack>
+#include <thread>
+#include <vector>
 #include "encoders/codecs/av1.hpp"
 #include "obs/obs-encoder-factory.hpp"
 #include "util/util-library.hpp"
@@ -42,6 +50,16 @@ namespace streamfx::encoder::aom::av1 {
 		std::vector<aom_image_t> _images;
 		aom_fixed_buf_t*         _global_headers;
 
+		// Packets, which OBS takes one at a time.
+		struct queued_packet {
+			encoder_packet       packet;
+			std::vector<uint8_t> data;
+		};
+		std::queue<queued_packet>        _packets;
+		std::mutex                       _packet_buffers_lock;
+		std::stack<std::vector<uint8_t>> _packet_buffers;
+		queued_packet                    _packet;
+
 		bool _initialized;
 		struct {
 			// Video (All Static)
@@ -59,10 +77,13 @@ namespace streamfx::encoder::aom::av1 {
 			aom_matrix_coefficients_t      color_matrix;
 			aom_color_range_t              color_range;
 			bool                           monochrome;
+			uint8_t                        bit_depth;
+			bool                           chroma_interleaved; // U and V share a plane, like in P010.
 
 			// Encoder
 			codec::av1::profile profile; // Static
 			int8_t              preset;
+			bool                preset_adaptive;
 
 			// Rate Control
 			aom_rc_mode rc_mode;      // Static
@@ -83,19 +104,56 @@ namespace streamfx::encoder::aom::av1 {
 			int32_t     kf_distance_max;
 
 			// Threads and Tiling (All Static)
+			bool             layout_automatic;
 			int8_t           threads;
 			int8_t           rowmultithreading;
 			int8_t           tile_columns;
 			int8_t           tile_rows;
 			aom_tune_metric  tune_metric;
 			aom_tune_content tune_content;
+
+			// Chunks (Static)
+			int8_t chunks;
 		} _settings;
 
-#ifdef ENABLE_PROFILING
+		// Chunked Encoding
+		struct chunk {
+			aom_codec_ctx_t                              ctx;
+			std::thread                                  worker;
+			std::queue<std::pair<aom_image_t*, int64_t>> frames;
+			std::queue<queued_packet>                    packets;
+			std::size_t                                  length;
+			std::size_t                                  delivered; // Packets handed to OBS.
+			bool                                         closed;
+			bool                                         done;
+		};
+		std::size_t                        _chunk_count;
+		std::size_t                        _chunk_length;
+		std::size_t                        _chunk_depth;
+		std::mutex                         _chunk_lock;
+		std::condition_variable            _chunk_submitted;
+		std::condition_variable            _chunk_completed;
+		bool                               _chunk_stop;
+		bool                               _chunk_error;
+		std::deque<std::shared_ptr<chunk>> _chunks;
+		std::stack<aom_image_t*>           _chunk_images;
+		std::size_t                        _chunk_images_allocated;
+		std::size_t                        _chunk_images_limit;
+
+		// Adaptive Speed
+		struct {
+			bool     enabled;
+			int8_t   minimum;
+			int8_t   maximum;
+			int8_t   current;
+			double   load;     // Smoothed encode time relative to the frame budget.
+			uint64_t budget;   // Time available per frame, in nanoseconds.
+			uint32_t cooldown; // Frames to wait until the next change.
+		} _speed;
+
 		std::shared_ptr<streamfx::util::profiler> _profiler_copy;
 		std::shared_ptr<streamfx::util::profiler> _profiler_encode;
 		std::shared_ptr<streamfx::util::profiler> _profiler_packet;
-#endif
 
 		public:
 		aom_av1_instance(obs_data_t* settings, obs_encoder_t* self, bool is_hw);
@@ -105,6 +163,12 @@ namespace streamfx::encoder::aom::av1 {
 
 		virtual bool update(obs_data_t* settings);
 
+		void automatic_layout(unsigned int usage, std::size_t cores);
+
+		void apply_static_controls(aom_codec_ctx_t* ctx);
+
+		void apply_dynamic_controls(aom_codec_ctx_t* ctx);
+
 		void log();
 
 		virtual bool get_extra_data(uint8_t** extra_data, size_t* size);
@@ -114,15 +178,42 @@ namespace streamfx::encoder::aom::av1 {
 		virtual void get_video_info(struct video_scale_info* info);
 
 		virtual bool encode_video(encoder_frame* frame, encoder_packet* packet, bool* received_packet);
+
+		private:
+		void prepare_image(aom_image_t& image);
+
+		void copy_image(encoder_frame* frame, aom_image_t& image);
+
+		void fill_packet(const aom_codec_cx_pkt_t* pkt, encoder_packet* packet);
+
+		std::size_t collect_packets(aom_codec_ctx_t* ctx, std::queue<queued_packet>& packets);
+
+		bool pop_packet(std::queue<queued_packet>& packets, encoder_packet* packet);
+
+		void adapt_speed(std::chrono::nanoseconds duration);
+
+		bool encode_chunked(encoder_frame* frame, encoder_packet* packet, bool* received_packet);
+
+		void chunk_main(std::shared_ptr<chunk> chunk);
 	};
 
 	class aom_av1_factory : public obs::encoder_factory<aom_av1_factory, aom_av1_instance> {
 		std::shared_ptr<::streamfx::util::library> _library;
+		std::vector<std::filesystem::path>         _library_paths;
+		std::once_flag                             _library_loaded;
+
+		void load_library();
 
 		public:
 		aom_av1_factory();
 		~aom_av1_factory();
 
+		/** Load libaom and resolve all functions, if this has not happened yet.
+		 *
+		 * Registration only probes for the library, so this must be called before any of the functions below are used.
+		 */
+		void load();
+
 		const char* get_name() override;
 
 		void* create(obs_data_t* settings, obs_encoder_t* encoder, bool is_hw) override;
@@ -21,6 +21,7 @@
 
 #include "encoder-ffmpeg.hpp"
 #include "strings.hpp"
+#include <chrono>
 #include <sstream>
 #include "codecs/hevc.hpp"
 #include "ffmpeg/tools.hpp"
@@ -80,6 +81,12 @@ extern "C" {
 #define ST_KEY_KEYFRAMES_INTERVAL_SECONDS "KeyFrames.Interval.Seconds"
 #define ST_KEY_KEYFRAMES_INTERVAL_FRAMES "KeyFrames.Interval.Frames"
 
+// Number of frames that may wait for the encode thread before encoding blocks.
+#define ST_ASYNC_QUEUE_SIZE 4
+
+// Number of frames in the frame pool beyond what the encoder and the encode thread can hold on to.
+#define ST_FRAME_POOL_RESERVE 2
+
 using namespace streamfx::encoder::ffmpeg;
 using namespace streamfx::encoder::codec;
 
@@ -92,13 +99,18 @@ ffmpeg_instance::ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool
 
 	  _codec(_factory->get_avcodec()), _context(nullptr), _handler(ffmpeg_manager::get()->get_handler(_codec->name)),
 
-	  _scaler(), _packet(),
+	  _conversion(), _packet(), _profiler_convert(streamfx::util::profiler::create("FFmpeg Convert")),
 
 	  _hwapi(), _hwinst(),
 
-	  _lag_in_frames(0), _sent_frames(0), _have_first_frame(false), _extra_data(), _sei_data(),
+	  _have_first_frame(false), _extra_data(), _sei_data(),
+
+	  _frame_pool(),
 
-	  _free_frames(), _used_frames(), _free_frames_last_used()
+	  _async_thread(), _async_lock(), _async_submitted(), _async_completed(), _async_stop(false), _async_error(false),
+	  _async_pending(0), _async_depth(0), _async_frames(), _async_packets(), _free_packets(),
+
+	  _parallel_contexts(), _parallel_threads(), _parallel_next_frame(0), _parallel_next_packet(0), _parallel_packets()
 {
 	// Initialize GPU Stuff
 	if (is_hw) {
@@ -130,9 +142,8 @@ ffmpeg_instance::ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool
 		throw std::runtime_error("Failed to create encoder context.");
 	}
 
-	// Create 8MB of precached Packet data for use later on.
+	// Only ever holds a reference moved out of a completed packet, so it needs no storage of its own.
 	av_init_packet(&_packet);
-	av_new_packet(&_packet, 8 * 1024 * 1024); // 8 MB precached Packet size.
 
 	// Initialize
 	if (is_hw) {
@@ -144,24 +155,92 @@ ffmpeg_instance::ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool
 	// Update settings
 	update(settings);
 
+	// Intra-only codecs can encode every frame on a context of its own, which scales with the number of cores far
+	// better than threading within a single context does.
+	std::size_t contexts = 1;
+	if (!_hwinst && _handler && _handler->has_frame_parallel_support(_factory)
+		&& ((_codec->capabilities & AV_CODEC_CAP_DELAY) == 0) && (_context->thread_count > 1)) {
+		contexts               = static_cast<size_t>(_context->thread_count);
+		_context->thread_count = 1;
+		_context->thread_type  = 0;
+		_context->delay        = 0;
+		for (std::size_t idx = 1; idx < contexts; idx++) {
+			_parallel_contexts.push_back(clone_context());
+		}
+		DLOG_INFO("[%s] Encoding frames in parallel on %zu contexts.", _codec->name, contexts);
+	}
+
 	// Initialize Encoder
-	auto gctx = streamfx::obs::gs::context();
-	int  res  = avcodec_open2(_context, _codec, NULL);
-	if (res < 0) {
-		throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+	{
+		auto gctx = streamfx::obs::gs::context();
+		int  res  = avcodec_open2(_context, _codec, NULL);
+		if (res < 0) {
+			throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+		}
+
+		for (auto context : _parallel_contexts) {
+			res = avcodec_open2(context, _codec, NULL);
+			if (res < 0) {
+				throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
+			}
+		}
+	}
+
+	// Software encoders run on their own thread, so that OBS only has to wait for them once the pipeline is full.
+	if (!_hwinst) {
+		// Grow the shared frame pool by every frame that this encoder can have in flight at once.
+		std::size_t capacity = ST_ASYNC_QUEUE_SIZE + ST_FRAME_POOL_RESERVE + (contexts - 1)
+							   + static_cast<size_t>(std::max(std::max(_context->delay, _context->thread_count), 1))
+							   + static_cast<size_t>(std::max(_context->max_b_frames, 0));
+		_frame_pool          = _conversion->get_pool();
+		_frame_pool->grow(capacity);
+
+		// Frames that are queued or being encoded, before OBS has to wait for a packet.
+		_async_depth = ST_ASYNC_QUEUE_SIZE + contexts;
+
+		if (contexts > 1) {
+			_parallel_threads.emplace_back(&ffmpeg_instance::parallel_main, this, _context);
+			for (auto context : _parallel_contexts) {
+				_parallel_threads.emplace_back(&ffmpeg_instance::parallel_main, this, context);
+			}
+		} else {
+			_async_thread = std::thread(&ffmpeg_instance::async_main, this);
+		}
 	}
 }
 
 ffmpeg_instance::~ffmpeg_instance()
 {
+	// Stop the encode threads, which finish the frames they were already given.
+	{
+		std::unique_lock<std::mutex> lock(_async_lock);
+		_async_stop = true;
+	}
+	_async_submitted.notify_all();
+	if (_async_thread.joinable()) {
+		_async_thread.join();
+	}
+	for (auto& thread : _parallel_threads) {
+		thread.join();
+	}
+	for (auto context : _parallel_contexts) {
+		avcodec_close(context);
+		avcodec_free_context(&context);
+	}
+	_parallel_contexts.clear();
+
+	// OBS keeps encoding until every output received a packet past its stop time, and packets leave in order, so
+	// anything still queued here was encoded after the outputs stopped.
+	std::size_t lost = _async_packets.size();
+
 	auto gctx = streamfx::obs::gs::context();
 	if (_context) {
 		// Flush encoders that require it.
 		if ((_codec->capabilities & AV_CODEC_CAP_DELAY) != 0) {
 			avcodec_send_frame(_context, nullptr);
 			while (avcodec_receive_packet(_context, &_packet) >= 0) {
-				avcodec_send_frame(_context, nullptr);
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				av_packet_unref(&_packet);
+				lost++;
 			}
 		}
 
@@ -172,7 +251,13 @@ ffmpeg_instance::~ffmpeg_instance()
 
 	av_packet_unref(&_packet);
 
-	_scaler.finalize();
+	if (lost > 0) {
+		DLOG_INFO("[%s] Discarded %zu packets encoded after the outputs stopped.", _codec->name, lost);
+	}
+	if (_frame_pool) {
+		DLOG_INFO("[%s] Frame pool of %zu frames missed %" PRIu64 " times.", _codec->name, _frame_pool->capacity(),
+				  _frame_pool->misses());
+	}
 }
 
 void ffmpeg_instance::get_properties(obs_properties_t* props)
@@ -285,16 +370,19 @@ bool ffmpeg_instance::update(obs_data_t* settings)
 					  ::streamfx::ffmpeg::tools::get_color_space_name(_context->colorspace),
 					  av_color_range_name(_context->color_range));
 		} else {
-			DLOG_INFO("[%s]     Input: %" PRId32 "x%" PRId32 " %s %s %s", _codec->name, _scaler.get_source_width(),
-					  _scaler.get_source_height(),
-					  ::streamfx::ffmpeg::tools::get_pixel_format_name(_scaler.get_source_format()),
-					  ::streamfx::ffmpeg::tools::get_color_space_name(_scaler.get_source_colorspace()),
-					  _scaler.is_source_full_range() ? "Full" : "Partial");
-			DLOG_INFO("[%s]     Output: %" PRId32 "x%" PRId32 " %s %s %s", _codec->name, _scaler.get_target_width(),
-					  _scaler.get_target_height(),
-					  ::streamfx::ffmpeg::tools::get_pixel_format_name(_scaler.get_target_format()),
-					  ::streamfx::ffmpeg::tools::get_color_space_name(_scaler.get_target_colorspace()),
-					  _scaler.is_target_full_range() ? "Full" : "Partial");
+			auto& scaler = _conversion->get_scaler();
+			DLOG_INFO("[%s]     Input: %" PRId32 "x%" PRId32 " %s %s %s", _codec->name, scaler.get_source_width(),
+					  scaler.get_source_height(),
+					  ::streamfx::ffmpeg::tools::get_pixel_format_name(scaler.get_source_format()),
+					  ::streamfx::ffmpeg::tools::get_color_space_name(scaler.get_source_colorspace()),
+					  scaler.is_source_full_range() ? "Full" : "Partial");
+			DLOG_INFO("[%s]     Output: %" PRId32 "x%" PRId32 " %s %s %s", _codec->name, scaler.get_target_width(),
+					  scaler.get_target_height(),
+					  ::streamfx::ffmpeg::tools::get_pixel_format_name(scaler.get_target_format()),
+					  ::streamfx::ffmpeg::tools::get_color_space_name(scaler.get_target_colorspace()),
+					  scaler.is_target_full_range() ? "Full" : "Partial");
+			DLOG_INFO("[%s]     Conversion: %zu slices, shared by %ld encoders", _codec->name, scaler.get_slices(),
+					  _conversion.use_count());
 			if (!_hwinst)
 				DLOG_INFO("[%s]     On GPU Index: %lli", _codec->name, obs_data_get_int(settings, ST_KEY_FFMPEG_GPU));
 		}
@@ -315,36 +403,6 @@ bool ffmpeg_instance::update(obs_data_t* settings)
 	return true;
 }
 
-static inline void copy_data(encoder_frame* frame, AVFrame* vframe)
-{
-	int h_chroma_shift, v_chroma_shift;
-	av_pix_fmt_get_chroma_sub_sample(static_cast<AVPixelFormat>(vframe->format), &h_chroma_shift, &v_chroma_shift);
-
-	for (std::size_t idx = 0; idx < MAX_AV_PLANES; idx++) {
-		if (!frame->data[idx] || !vframe->data[idx])
-			continue;
-
-		std::size_t plane_height = static_cast<size_t>(vframe->height) >> (idx ? v_chroma_shift : 0);
-
-		if (static_cast<uint32_t>(vframe->linesize[idx]) == frame->linesize[idx]) {
-			std::memcpy(vframe->data[idx], frame->data[idx], frame->linesize[idx] * plane_height);
-		} else {
-			std::size_t ls_in  = static_cast<size_t>(frame->linesize[idx]);
-			std::size_t ls_out = static_cast<size_t>(vframe->linesize[idx]);
-			std::size_t bytes  = ls_in < ls_out ? ls_in : ls_out;
-
-			uint8_t* to   = vframe->data[idx];
-			uint8_t* from = frame->data[idx];
-
-			for (std::size_t y = 0; y < plane_height; y++) {
-				std::memcpy(to, from, bytes);
-				to += ls_out;
-				from += ls_in;
-			}
-		}
-	}
-}
-
 bool ffmpeg_instance::encode_audio(struct encoder_frame* frame, struct encoder_packet* packet, bool* received_packet)
 {
 	throw std::logic_error("The method or operation is not implemented.");
@@ -352,31 +410,22 @@ bool ffmpeg_instance::encode_audio(struct encoder_frame* frame, struct encoder_p
 
 bool ffmpeg_instance::encode_video(struct encoder_frame* frame, struct encoder_packet* packet, bool* received_packet)
 {
-	std::shared_ptr<AVFrame> vframe = pop_free_frame(); // Retrieve an empty frame.
+	std::shared_ptr<AVFrame> vframe;
 
-	// Convert frame.
+	// Convert frame, or share the conversion with other encoders.
 	{
-		vframe->height          = _context->height;
-		vframe->format          = _context->pix_fmt;
+		auto profile = _profiler_convert->track();
+		if (int res = _conversion->convert(this, frame, vframe); res < 0) {
+			DLOG_ERROR("Failed to convert frame: %s (%" PRId32 ").",
+					   ::streamfx::ffmpeg::tools::get_error_description(res), res);
+			return false;
+		}
+
 		vframe->color_range     = _context->color_range;
 		vframe->colorspace      = _context->colorspace;
 		vframe->color_primaries = _context->color_primaries;
 		vframe->color_trc       = _context->color_trc;
 		vframe->pts             = frame->pts;
-
-		if ((_scaler.is_source_full_range() == _scaler.is_target_full_range())
-			&& (_scaler.get_source_colorspace() == _scaler.get_target_colorspace())
-			&& (_scaler.get_source_format() == _scaler.get_target_format())) {
-			copy_data(frame, vframe.get());
-		} else {
-			int res = _scaler.convert(reinterpret_cast<uint8_t**>(frame->data), reinterpret_cast<int*>(frame->linesize),
-									  0, _context->height, vframe->data, vframe->linesize);
-			if (res <= 0) {
-				DLOG_ERROR("Failed to convert frame: %s (%" PRId32 ").",
-						   ::streamfx::ffmpeg::tools::get_error_description(res), res);
-				return false;
-			}
-		}
 	}
 
 	if (!encode_avframe(vframe, packet, received_packet))
@@ -465,25 +514,16 @@ void ffmpeg_instance::initialize_sw(obs_data_t* settings)
 		// provides better support for scaling algorithms, such as Bicubic.
 		_context->chroma_sample_location = AVCHROMA_LOC_CENTER;
 
-		_scaler.set_source_size(static_cast<uint32_t>(_context->width), static_cast<uint32_t>(_context->height));
-		_scaler.set_source_color(_context->color_range == AVCOL_RANGE_JPEG, _context->colorspace);
-		_scaler.set_source_format(_pixfmt_source);
-
-		_scaler.set_target_size(static_cast<uint32_t>(_context->width), static_cast<uint32_t>(_context->height));
-		_scaler.set_target_color(_context->color_range == AVCOL_RANGE_JPEG, _context->colorspace);
-		_scaler.set_target_format(_pixfmt_target);
-
-		// Create Scaler
-		if (!_scaler.initialize(SWS_POINT)) {
-			std::stringstream sstr;
-			sstr << "Initializing scaler failed for conversion from '"
-				 << ::streamfx::ffmpeg::tools::get_pixel_format_name(_scaler.get_source_format()) << "' to '"
-				 << ::streamfx::ffmpeg::tools::get_pixel_format_name(_scaler.get_target_format())
-				 << "' with color space '"
-				 << ::streamfx::ffmpeg::tools::get_color_space_name(_scaler.get_source_colorspace()) << "' and "
-				 << (_scaler.is_source_full_range() ? "full" : "partial") << " range.";
-			throw std::runtime_error(sstr.str());
-		}
+		// Share the conversion with every other encoder that wants the same frames in the same format.
+		::streamfx::ffmpeg::conversion_stage::format source, target;
+		source.width        = static_cast<uint32_t>(_context->width);
+		source.height       = static_cast<uint32_t>(_context->height);
+		source.pixel_format = _pixfmt_source;
+		source.color_space  = _context->colorspace;
+		source.full_range   = _context->color_range == AVCOL_RANGE_JPEG;
+		target              = source;
+		target.pixel_format = _pixfmt_target;
+		_conversion         = ::streamfx::ffmpeg::conversion_stage::get(source, target);
 	}
 }
 
@@ -523,59 +563,76 @@ void ffmpeg_instance::initialize_hw(obs_data_t*)
 #endif
 }
 
+AVCodecContext* ffmpeg_instance::clone_context()
+{
+	AVCodecContext* context = avcodec_alloc_context3(_codec);
+	if (!context) {
+		DLOG_ERROR("Failed to create context for encoder '%s'.", _codec->name);
+		throw std::runtime_error("Failed to create encoder context.");
+	}
+
+	// Copy all options, including those private to the encoder.
+	if ((av_opt_copy(context, _context) < 0)
+		|| (context->priv_data && _context->priv_data && (av_opt_copy(context->priv_data, _context->priv_data) < 0))) {
+		avcodec_free_context(&context);
+		throw std::runtime_error("Failed to copy encoder settings.");
+	}
+
+	// Copy what is not exposed as an option.
+	context->width                  = _context->width;
+	context->height                 = _context->height;
+	context->pix_fmt                = _context->pix_fmt;
+	context->time_base              = _context->time_base;
+	context->framerate              = _context->framerate;
+	context->sample_aspect_ratio    = _context->sample_aspect_ratio;
+	context->field_order            = _context->field_order;
+	context->color_range            = _context->color_range;
+	context->colorspace             = _context->colorspace;
+	context->color_primaries        = _context->color_primaries;
+	context->color_trc              = _context->color_trc;
+	context->chroma_sample_location = _context->chroma_sample_location;
+	context->profile                = _context->profile;
+	context->thread_count           = _context->thread_count;
+	context->thread_type            = _context->thread_type;
+	context->delay                  = _context->delay;
+
+	return context;
+}
+
 void ffmpeg_instance::push_free_frame(std::shared_ptr<AVFrame> frame)
 {
-	auto now = std::chrono::high_resolution_clock::now();
-	if (_free_frames.size() > 0) {
-		if ((now - _free_frames_last_used) < std::chrono::seconds(1)) {
-			_free_frames.push(frame);
-		}
-	} else {
-		_free_frames.push(frame);
-		_free_frames_last_used = std::chrono::high_resolution_clock::now();
+	if (_frame_pool) {
+		_frame_pool->release(frame);
 	}
 }
 
 std::shared_ptr<AVFrame> ffmpeg_instance::pop_free_frame()
 {
-	std::shared_ptr<AVFrame> frame;
-	if (_free_frames.size() > 0) {
-		// Re-use existing frames first.
-		frame = _free_frames.top();
-		_free_frames.pop();
+	if (_hwinst) {
+		return _hwinst->allocate_frame(_context->hw_frames_ctx);
 	} else {
-		if (_hwinst) {
-			frame = _hwinst->allocate_frame(_context->hw_frames_ctx);
-		} else {
-			frame = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
-				av_frame_unref(frame);
-				av_frame_free(&frame);
-			});
-
-			frame->width  = _context->width;
-			frame->height = _context->height;
-			frame->format = _context->pix_fmt;
-
-			int res = av_frame_get_buffer(frame.get(), 32);
-			if (res < 0) {
-				throw std::runtime_error(::streamfx::ffmpeg::tools::get_error_description(res));
-			}
-		}
+		return _frame_pool->acquire();
 	}
-
-	return frame;
 }
 
-void ffmpeg_instance::push_used_frame(std::shared_ptr<AVFrame> frame)
+void ffmpeg_instance::push_free_packet(std::shared_ptr<AVPacket> packet)
 {
-	_used_frames.push(frame);
+	std::unique_lock<std::mutex> lock(_async_lock);
+	_free_packets.push(packet);
 }
 
-std::shared_ptr<AVFrame> ffmpeg_instance::pop_used_frame()
+std::shared_ptr<AVPacket> ffmpeg_instance::pop_free_packet()
 {
-	auto frame = _used_frames.front();
-	_used_frames.pop();
-	return frame;
+	{
+		std::unique_lock<std::mutex> lock(_async_lock);
+		if (_free_packets.size() > 0) {
+			auto packet = _free_packets.top();
+			_free_packets.pop();
+			return packet;
+		}
+	}
+
+	return std::shared_ptr<AVPacket>(av_packet_alloc(), [](AVPacket* packet) { av_packet_free(&packet); });
 }
 
 bool ffmpeg_instance::get_extra_data(uint8_t** data, size_t* size)
@@ -602,24 +659,28 @@ void ffmpeg_instance::get_video_info(struct video_scale_info* info)
 {
 	if (!is_hardware_encode()) {
 		// Override input with supported format if software encode.
-		info->format = ::streamfx::ffmpeg::tools::avpixelformat_to_obs_videoformat(_scaler.get_source_format());
+		info->format = ::streamfx::ffmpeg::tools::avpixelformat_to_obs_videoformat(
+			_conversion->get_scaler().get_source_format());
 	}
 }
 
-int ffmpeg_instance::receive_packet(bool* received_packet, struct encoder_packet* packet)
+bool ffmpeg_instance::receive_packet(bool* received_packet, struct encoder_packet* packet)
 {
-	int res = 0;
-
-	av_packet_unref(&_packet);
-
+	std::shared_ptr<AVPacket> completed;
 	{
-		auto gctx = streamfx::obs::gs::context();
-		res       = avcodec_receive_packet(_context, &_packet);
-	}
-	if (res != 0) {
-		return res;
+		std::unique_lock<std::mutex> lock(_async_lock);
+		if (_async_packets.empty()) {
+			return false;
+		}
+		completed = _async_packets.front();
+		_async_packets.pop();
 	}
 
+	// Keep the packet data alive until the next call, as OBS only copies it later.
+	av_packet_unref(&_packet);
+	av_packet_move_ref(&_packet, completed.get());
+	push_free_packet(completed);
+
 	if (!_have_first_frame) {
 		if (_codec->id == AV_CODEC_ID_H264) {
 			uint8_t*    tmp_packet;
@@ -669,98 +730,201 @@ int ffmpeg_instance::receive_packet(bool* received_packet, struct encoder_packet
 	packet->drop_priority = packet->keyframe ? 0 : 1;
 	*received_packet      = true;
 
-	push_free_frame(pop_used_frame());
-
-	return res;
+	return true;
 }
 
 int ffmpeg_instance::send_frame(std::shared_ptr<AVFrame> const frame)
 {
 	int res = 0;
-	{
+	if (_hwinst) {
 		auto gctx = streamfx::obs::gs::context();
 		res       = avcodec_send_frame(_context, frame.get());
+	} else {
+		res = avcodec_send_frame(_context, frame.get());
 	}
 	if (res == 0) {
-		push_used_frame(frame);
+		// The encoder holds its own reference to the frame data, which returns to the pool once it is done with it.
+		push_free_frame(frame);
 	}
 
 	return res;
 }
 
-bool ffmpeg_instance::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_packet* packet, bool* received_packet)
+int ffmpeg_instance::drain_packets()
 {
-	bool sent_frame  = false;
-	bool recv_packet = false;
-	bool should_lag  = (_sent_frames >= _lag_in_frames);
-
-	auto loop_begin = std::chrono::high_resolution_clock::now();
-	auto loop_end   = loop_begin + std::chrono::milliseconds(50);
-
-	while ((!sent_frame || (should_lag && !recv_packet)) && !(std::chrono::high_resolution_clock::now() > loop_end)) {
-		bool eagain_is_stupid = false;
-
-		if (!sent_frame) {
-			int res = send_frame(frame);
-			switch (res) {
-			case 0:
-				sent_frame = true;
-				frame      = nullptr;
-				break;
-			case AVERROR(EAGAIN):
-				// This means we should call receive_packet again, but what do we do with that data?
-				// Why can't we queue on both? Do I really have to implement threading for this stuff?
-				if (*received_packet == true) {
-					DLOG_WARNING("Skipped frame due to EAGAIN when a packet was already returned.");
-					sent_frame = true;
-				}
-				eagain_is_stupid = true;
-				break;
-			case AVERROR(EOF):
-				DLOG_ERROR("Skipped frame due to end of stream.");
-				sent_frame = true;
-				break;
-			default:
-				DLOG_ERROR("Failed to encode frame: %s (%" PRId32 ").",
-						   ::streamfx::ffmpeg::tools::get_error_description(res), res);
-				return false;
+	int count = 0;
+	while (true) {
+		auto packet = pop_free_packet();
+
+		int res = 0;
+		if (_hwinst) {
+			auto gctx = streamfx::obs::gs::context();
+			res       = avcodec_receive_packet(_context, packet.get());
+		} else {
+			res = avcodec_receive_packet(_context, packet.get());
+		}
+
+		if (res != 0) {
+			push_free_packet(packet);
+			if ((res == AVERROR(EAGAIN)) || (res == AVERROR_EOF)) {
+				return count;
 			}
+			DLOG_ERROR("Failed to receive packet: %s (%" PRId32 ").",
+					   ::streamfx::ffmpeg::tools::get_error_description(res), res);
+			return res;
 		}
 
-		if (!recv_packet) {
-			int res = receive_packet(received_packet, packet);
-			switch (res) {
-			case 0:
-				recv_packet = true;
-				break;
-			case AVERROR(EOF):
-				DLOG_ERROR("Received end of file.");
-				recv_packet = true;
-				break;
-			case AVERROR(EAGAIN):
-				if (sent_frame) {
-					recv_packet = true;
-				}
-				if (eagain_is_stupid) {
-					DLOG_ERROR("Both send and recieve returned EAGAIN, encoder is broken.");
-					return false;
-				}
-				break;
-			default:
-				DLOG_ERROR("Failed to receive packet: %s (%" PRId32 ").",
-						   ::streamfx::ffmpeg::tools::get_error_description(res), res);
-				return false;
+		{
+			std::unique_lock<std::mutex> lock(_async_lock);
+			_async_packets.push(packet);
+		}
+		count++;
+	}
+}
+
+int ffmpeg_instance::submit_frame(std::shared_ptr<AVFrame> frame)
+{
+	while (true) {
+		int res = send_frame(frame);
+		if (res == 0) {
+			break;
+		} else if (res == AVERROR(EAGAIN)) {
+			// The encoder will only accept new frames once its output has been read.
+			int count = drain_packets();
+			if (count < 0) {
+				return count;
+			} else if (count == 0) {
+				DLOG_ERROR("Both send and receive returned EAGAIN, encoder is broken.");
+				return AVERROR_BUG;
 			}
+		} else if (res == AVERROR_EOF) {
+			DLOG_ERROR("Skipped frame due to end of stream.");
+			push_free_frame(frame);
+			break;
+		} else {
+			DLOG_ERROR("Failed to encode frame: %s (%" PRId32 ").",
+					   ::streamfx::ffmpeg::tools::get_error_description(res), res);
+			push_free_frame(frame);
+			return res;
+		}
+	}
+
+	int res = drain_packets();
+	return (res < 0) ? res : 0;
+}
+
+void ffmpeg_instance::async_main()
+{
+	std::unique_lock<std::mutex> lock(_async_lock);
+	while (true) {
+		_async_submitted.wait(lock, [this]() { return _async_stop || !_async_frames.empty(); });
+		if (_async_frames.empty()) {
+			break;
+		}
+
+		auto frame = _async_frames.front();
+		_async_frames.pop();
+		if (_async_error) { // Drop anything that is left after a failure.
+			_async_pending--;
+			continue;
 		}
 
-		if (!sent_frame || !recv_packet) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		lock.unlock();
+		int res = submit_frame(frame);
+		lock.lock();
+
+		_async_pending--;
+		if (res < 0) {
+			_async_error = true;
 		}
+		_async_completed.notify_all();
 	}
+}
+
+void ffmpeg_instance::parallel_main(AVCodecContext* context)
+{
+	std::unique_lock<std::mutex> lock(_async_lock);
+	while (true) {
+		_async_submitted.wait(lock, [this]() { return _async_stop || !_async_frames.empty(); });
+		if (_async_frames.empty()) {
+			break;
+		}
 
-	if (!sent_frame)
+		// Frames are taken in order, which is also the order their packets have to be output in.
+		auto     frame = _async_frames.front();
+		uint64_t index = _parallel_next_frame++;
+		bool     skip  = _async_error; // Drop anything that is left after a failure.
+		_async_frames.pop();
+
+		lock.unlock();
+		std::shared_ptr<AVPacket> packet;
+		int                       res = 0;
+		if (!skip) {
+			packet = pop_free_packet();
+			res    = avcodec_send_frame(context, frame.get());
+			if (res == 0) {
+				// Without delay, the packet for a frame is available as soon as the frame was sent.
+				res = avcodec_receive_packet(context, packet.get());
+			}
+			if (res < 0) {
+				push_free_packet(packet);
+				packet.reset();
+				if (res != AVERROR(EAGAIN)) {
+					DLOG_ERROR("Failed to encode frame: %s (%" PRId32 ").",
+							   ::streamfx::ffmpeg::tools::get_error_description(res), res);
+				}
+			}
+		}
 		push_free_frame(frame);
+		lock.lock();
+
+		_async_pending--;
+		if ((res < 0) && (res != AVERROR(EAGAIN))) {
+			_async_error = true;
+		}
 
+		// Output packets once every earlier frame is done as well.
+		_parallel_packets.emplace(index, packet);
+		for (auto kv = _parallel_packets.begin();
+			 (kv != _parallel_packets.end()) && (kv->first == _parallel_next_packet);
+			 kv = _parallel_packets.erase(kv)) {
+			if (kv->second) {
+				_async_packets.push(kv->second);
+			}
+			_parallel_next_packet++;
+		}
+		_async_completed.notify_all();
+	}
+}
+
+bool ffmpeg_instance::encode_avframe(std::shared_ptr<AVFrame> frame, encoder_packet* packet, bool* received_packet)
+{
+	if (_hwinst) {
+		// Texture encoding is called with the graphics context, which the encode thread would need as well.
+		if (submit_frame(frame) < 0) {
+			return false;
+		}
+	} else {
+		std::unique_lock<std::mutex> lock(_async_lock);
+		if (_async_error) {
+			return false;
+		}
+
+		_async_frames.push(frame);
+		_async_pending++;
+		_async_submitted.notify_one();
+
+		// OBS takes at most one packet per frame. Once the pipeline is full, wait for a packet to hand out, so that one
+		// leaves for every frame that arrives and the latency stays at the pipeline depth plus the encoder's own delay.
+		_async_completed.wait(lock, [this]() {
+			return _async_error || !_async_packets.empty() || (_async_pending < _async_depth);
+		});
+		if (_async_error) {
+			return false;
+		}
+	}
+
+	receive_packet(received_packet, packet);
 	return true;
 }
 
@@ -1160,38 +1324,47 @@ ffmpeg_manager::~ffmpeg_manager()
 
 void ffmpeg_manager::register_encoders()
 {
-	// Encoders
-#if FF_API_NEXT
-	void* iterator = nullptr;
-	for (const AVCodec* codec = av_codec_iterate(&iterator); codec != nullptr; codec = av_codec_iterate(&iterator)) {
+	// Time the walk over libavcodec apart from creating and registering the factories, which is the only part that a
+	// cache could not skip. This decides whether caching the codec list on disk would be worth anything.
+	auto                     start       = std::chrono::steady_clock::now();
+	std::chrono::nanoseconds registering = std::chrono::nanoseconds(0);
+	std::size_t              encoders    = 0;
+
+	auto add = [this, &registering, &encoders](const AVCodec* codec) {
 		// Only register encoders.
 		if (!av_codec_is_encoder(codec))
-			continue;
+			return;
 
 		if ((codec->type == AVMediaType::AVMEDIA_TYPE_AUDIO) || (codec->type == AVMediaType::AVMEDIA_TYPE_VIDEO)) {
+			auto begin = std::chrono::steady_clock::now();
 			try {
 				_factories.emplace(codec, std::make_shared<ffmpeg_factory>(codec));
+				encoders++;
 			} catch (const std::exception& ex) {
 				DLOG_ERROR("Failed to register encoder '%s': %s", codec->name, ex.what());
 			}
+			registering += std::chrono::steady_clock::now() - begin;
 		}
+	};
+
+	// Encoders
+#if FF_API_NEXT
+	void* iterator = nullptr;
+	for (const AVCodec* codec = av_codec_iterate(&iterator); codec != nullptr; codec = av_codec_iterate(&iterator)) {
+		add(codec);
 	}
 #else
 	AVCodec* codec = nullptr;
 	for (codec = av_codec_next(codec); codec != nullptr; codec = av_codec_next(codec)) {
-		// Only register encoders.
-		if (!av_codec_is_encoder(codec))
-			continue;
-
-		if ((codec->type == AVMediaType::AVMEDIA_TYPE_AUDIO) || (codec->type == AVMediaType::AVMEDIA_TYPE_VIDEO)) {
-			try {
-				_factories.emplace(codec, std::make_shared<ffmpeg_factory>(codec));
-			} catch (const std::exception& ex) {
-				DLOG_ERROR("Failed to register encoder '%s': %s", codec->name, ex.what());
-			}
-		}
+		add(codec);
 	}
 #endif
+
+	auto total = std::chrono::steady_clock::now() - start;
+	DLOG_INFO("Registered %zu encoders in %.3f ms: %.3f ms walking libavcodec, %.3f ms creating and registering.",
+			  encoders, std::chrono::duration<double, std::milli>(total).count(),
+			  std::chrono::duration<double, std::milli>(total - registering).count(),
+			  std::chrono::duration<double, std::milli>(registering).count());
 }
 
 void ffmpeg_manager::register_handler(std::string codec, std::shared_ptr<handler::handler> handler)
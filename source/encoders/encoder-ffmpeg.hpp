@@ -28,9 +28,9 @@
 #include <stack>
 #include <thread>
 #include <vector>
-#include "ffmpeg/avframe-queue.hpp"
+#include "ffmpeg/avframe-pool.hpp"
+#include "ffmpeg/conversion-stage.hpp"
 #include "ffmpeg/hwapi/base.hpp"
-#include "ffmpeg/swscale.hpp"
 #include "handlers/handler.hpp"
 #include "obs/obs-encoder-factory.hpp"
 
@@ -57,24 +57,40 @@ namespace streamfx::encoder::ffmpeg {
 
 		std::shared_ptr<handler::handler> _handler;
 
-		::streamfx::ffmpeg::swscale _scaler;
-		AVPacket                    _packet;
+		std::shared_ptr<::streamfx::ffmpeg::conversion_stage> _conversion;
+		AVPacket                                              _packet;
+		std::shared_ptr<streamfx::util::profiler>             _profiler_convert;
 
 		std::shared_ptr<::streamfx::ffmpeg::hwapi::base>     _hwapi;
 		std::shared_ptr<::streamfx::ffmpeg::hwapi::instance> _hwinst;
 
-		std::size_t _lag_in_frames;
-		std::size_t _sent_frames;
-
 		// Extra Data
 		bool                 _have_first_frame;
 		std::vector<uint8_t> _extra_data;
 		std::vector<uint8_t> _sei_data;
 
-		// Frame Stack and Queue
-		std::stack<std::shared_ptr<AVFrame>>           _free_frames;
-		std::queue<std::shared_ptr<AVFrame>>           _used_frames;
-		std::chrono::high_resolution_clock::time_point _free_frames_last_used;
+		// Frame Pool
+		std::shared_ptr<::streamfx::ffmpeg::avframe_pool> _frame_pool;
+
+		// Asynchronous Encoding
+		std::thread                           _async_thread;
+		std::mutex                            _async_lock;
+		std::condition_variable               _async_submitted;
+		std::condition_variable               _async_completed;
+		bool                                  _async_stop;
+		bool                                  _async_error;
+		std::size_t                           _async_pending;
+		std::size_t                           _async_depth;
+		std::queue<std::shared_ptr<AVFrame>>  _async_frames;
+		std::queue<std::shared_ptr<AVPacket>> _async_packets;
+		std::stack<std::shared_ptr<AVPacket>> _free_packets;
+
+		// Frame Parallel Encoding
+		std::vector<AVCodecContext*>                  _parallel_contexts;
+		std::vector<std::thread>                      _parallel_threads;
+		uint64_t                                      _parallel_next_frame;
+		uint64_t                                      _parallel_next_packet;
+		std::map<uint64_t, std::shared_ptr<AVPacket>> _parallel_packets;
 
 		public:
 		ffmpeg_instance(obs_data_t* settings, obs_encoder_t* self, bool is_hw);
@@ -104,16 +120,26 @@ namespace streamfx::encoder::ffmpeg {
 		void initialize_sw(obs_data_t* settings);
 		void initialize_hw(obs_data_t* settings);
 
+		AVCodecContext* clone_context();
+
 		void                     push_free_frame(std::shared_ptr<AVFrame> frame);
 		std::shared_ptr<AVFrame> pop_free_frame();
 
-		void                     push_used_frame(std::shared_ptr<AVFrame> frame);
-		std::shared_ptr<AVFrame> pop_used_frame();
+		void                      push_free_packet(std::shared_ptr<AVPacket> packet);
+		std::shared_ptr<AVPacket> pop_free_packet();
 
-		int receive_packet(bool* received_packet, struct encoder_packet* packet);
+		bool receive_packet(bool* received_packet, struct encoder_packet* packet);
 
 		int send_frame(std::shared_ptr<AVFrame> frame);
 
+		int drain_packets();
+
+		int submit_frame(std::shared_ptr<AVFrame> frame);
+
+		void async_main();
+
+		void parallel_main(AVCodecContext* context);
+
 		bool encode_avframe(std::shared_ptr<AVFrame> frame, struct encoder_packet* packet, bool* received_packet);
 
 		public: // Handler API
@@ -61,6 +61,8 @@ namespace streamfx::encoder::ffmpeg {
 
 			virtual bool has_pixel_format_support(ffmpeg_factory* instance);
 
+			virtual bool has_frame_parallel_support(ffmpeg_factory* instance);
+
 			public /*settings*/:
 			virtual void get_properties(obs_properties_t* props, const AVCodec* codec, AVCodecContext* context,
 										bool hw_encode){};
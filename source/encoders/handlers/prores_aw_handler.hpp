@@ -45,6 +45,8 @@ namespace streamfx::encoder::ffmpeg::handler {
 		public /*support tests*/:
 		bool has_pixel_format_support(ffmpeg_factory* instance) override;
 
+		bool has_frame_parallel_support(ffmpeg_factory* instance) override;
+
 		public /*settings*/:
 		void get_properties(obs_properties_t* props, const AVCodec* codec, AVCodecContext* context,
 							bool hw_encode) override;
@@ -0,0 +1,203 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2021 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "avframe-pool.hpp"
+#include <vector>
+#include "tools.hpp"
+
+extern "C" {
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4242 4244 4365)
+#endif
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+}
+
+// Alignment of lines and planes, same as used for av_frame_get_buffer elsewhere.
+#define ST_ALIGNMENT 32
+
+using namespace streamfx::ffmpeg;
+
+#if LIBAVUTIL_VERSION_MAJOR < 57
+typedef int buffer_size_t;
+#else
+typedef size_t buffer_size_t;
+#endif
+
+// AVBufferPool allocates on the thread that asked for a buffer, so this tells whether this thread's last request had
+// to allocate, regardless of what other threads are doing with the pool.
+static thread_local bool plane_allocated = false;
+
+static AVBufferRef* allocate_plane(void*, buffer_size_t size)
+{
+	plane_allocated = true;
+	return av_buffer_alloc(size);
+}
+
+avframe_pool::avframe_pool(int32_t width, int32_t height, AVPixelFormat format, std::size_t capacity)
+	: _width(width), _height(height), _format(format), _capacity(capacity), _pools(), _linesizes(), _planes(0),
+	  _lock(), _frames(), _misses(0)
+{
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+		throw std::invalid_argument("format");
+	}
+
+	// Lay out the planes the same way av_frame_get_buffer would.
+	if (int res = av_image_fill_linesizes(_linesizes.data(), format, FFALIGN(width, ST_ALIGNMENT)); res < 0) {
+		throw std::runtime_error(tools::get_error_description(res));
+	}
+	_planes = av_pix_fmt_count_planes(format);
+	for (int plane = 0; plane < _planes; plane++) {
+		int lines         = ((plane == 1) || (plane == 2)) ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+		int size          = FFALIGN(_linesizes[plane], ST_ALIGNMENT) * lines + ST_ALIGNMENT;
+		_linesizes[plane] = FFALIGN(_linesizes[plane], ST_ALIGNMENT);
+		_pools[plane]     = av_buffer_pool_init2(size, nullptr, allocate_plane, nullptr);
+		if (!_pools[plane]) {
+			throw std::bad_alloc();
+		}
+	}
+
+	// Fill the pool, so that nothing has to be allocated later on.
+	fill(capacity);
+}
+
+avframe_pool::~avframe_pool()
+{
+	// Buffers still referenced elsewhere keep their pool alive until they are released.
+	for (auto& pool : _pools) {
+		if (pool) {
+			av_buffer_pool_uninit(&pool);
+		}
+	}
+}
+
+std::shared_ptr<AVFrame> avframe_pool::pop_frame(bool& missed)
+{
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (!_frames.empty()) {
+			auto frame = _frames.top();
+			_frames.pop();
+			return frame;
+		}
+	}
+
+	auto frame = std::shared_ptr<AVFrame>(av_frame_alloc(), [](AVFrame* frame) {
+		av_frame_unref(frame);
+		av_frame_free(&frame);
+	});
+	if (!frame) {
+		throw std::bad_alloc();
+	}
+	missed = true;
+	return frame;
+}
+
+std::shared_ptr<AVFrame> avframe_pool::take(bool track_misses)
+{
+	bool missed = false;
+
+	auto frame = pop_frame(missed);
+
+	frame->width  = _width;
+	frame->height = _height;
+	frame->format = _format;
+	for (int plane = 0; plane < _planes; plane++) {
+		plane_allocated   = false;
+		frame->buf[plane] = av_buffer_pool_get(_pools[plane]);
+		missed            = missed || plane_allocated;
+		if (!frame->buf[plane]) {
+			release(frame);
+			throw std::bad_alloc();
+		}
+		frame->data[plane] = reinterpret_cast<uint8_t*>(FFALIGN(reinterpret_cast<uintptr_t>(frame->buf[plane]->data),
+																ST_ALIGNMENT));
+		frame->linesize[plane] = _linesizes[plane];
+	}
+	frame->extended_data = frame->data;
+
+	if (track_misses && missed) {
+		_misses.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return frame;
+}
+
+void avframe_pool::fill(std::size_t frames)
+{
+	std::vector<std::shared_ptr<AVFrame>> taken;
+	taken.reserve(frames);
+	for (std::size_t n = 0; n < frames; n++) {
+		taken.push_back(take(false));
+	}
+	for (auto& frame : taken) {
+		release(frame);
+	}
+}
+
+std::shared_ptr<AVFrame> avframe_pool::acquire()
+{
+	return take(true);
+}
+
+std::shared_ptr<AVFrame> avframe_pool::reference(const AVFrame* source)
+{
+	bool missed = false;
+	auto frame  = pop_frame(missed);
+	if (av_frame_ref(frame.get(), source) < 0) {
+		release(frame);
+		return nullptr;
+	}
+
+	if (missed) {
+		_misses.fetch_add(1, std::memory_order_relaxed);
+	}
+	return frame;
+}
+
+void avframe_pool::release(std::shared_ptr<AVFrame> frame)
+{
+	av_frame_unref(frame.get());
+
+	std::unique_lock<std::mutex> lock(_lock);
+	_frames.push(frame);
+}
+
+void avframe_pool::grow(std::size_t frames)
+{
+	_capacity.fetch_add(frames);
+	fill(frames);
+}
+
+std::size_t avframe_pool::capacity()
+{
+	return _capacity.load();
+}
+
+uint64_t avframe_pool::misses()
+{
+	return _misses.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,97 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2021 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "common.hpp"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <stack>
+
+extern "C" {
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4242 4244 4365)
+#endif
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+}
+
+namespace streamfx::ffmpeg {
+	/** A pool of identical video frames, whose planes are taken from an AVBufferPool.
+	 *
+	 * Released frames only give up their references to the planes, which return to the pool once everyone else (such
+	 * as an encoder) is done with them too. Acquiring a frame never has to wait, but if the pool runs dry a new frame
+	 * is allocated and counted as a miss.
+	 */
+	class avframe_pool {
+		int32_t                  _width;
+		int32_t                  _height;
+		AVPixelFormat            _format;
+		std::atomic<std::size_t> _capacity;
+
+		std::array<AVBufferPool*, 4> _pools;
+		std::array<int, 4>           _linesizes;
+		int                          _planes;
+
+		std::mutex                           _lock;
+		std::stack<std::shared_ptr<AVFrame>> _frames;
+
+		std::atomic<uint64_t> _misses;
+
+		std::shared_ptr<AVFrame> pop_frame(bool& missed);
+
+		std::shared_ptr<AVFrame> take(bool track_misses);
+
+		void fill(std::size_t frames);
+
+		public:
+		/** Create a pool and pre-allocate enough frames to fill it.
+		 *
+		 * @param capacity Number of frames expected to be in use at the same time.
+		 */
+		avframe_pool(int32_t width, int32_t height, AVPixelFormat format, std::size_t capacity);
+		~avframe_pool();
+
+		std::shared_ptr<AVFrame> acquire();
+
+		/** Acquire a frame that references the planes of another frame, instead of planes from the pool.
+		 *
+		 * @return The new reference, or nullptr if referencing failed.
+		 */
+		std::shared_ptr<AVFrame> reference(const AVFrame* source);
+
+		void release(std::shared_ptr<AVFrame> frame);
+
+		/** Pre-allocate more frames, for when another user starts to share the pool.
+		 */
+		void grow(std::size_t frames);
+
+		std::size_t capacity();
+
+		/** Number of frames that had to be allocated after the pool was filled.
+		 */
+		uint64_t misses();
+	};
+} // namespace streamfx::ffmpeg
@@ -0,0 +1,209 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2021 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "conversion-stage.hpp"
+#include <map>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include "tools.hpp"
+#include "plugin.hpp"
+#include "util/util-threadpool.hpp"
+
+extern "C" {
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4242 4244 4365)
+#endif
+#include <libavutil/pixdesc.h>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+}
+
+// Number of rows copied by a single task when copying frames in parallel.
+#define ST_COPY_ROWS_PER_TASK 64
+
+// Frames the stage itself holds on to: the most recent conversion, and the one replacing it.
+#define ST_POOL_CAPACITY 2
+
+using namespace streamfx::ffmpeg;
+
+typedef std::tuple<uint32_t, uint32_t, AVPixelFormat, AVColorSpace, bool, uint32_t, uint32_t, AVPixelFormat,
+				   AVColorSpace, bool>
+	stage_key_t;
+
+static std::mutex                                             _stages_lock;
+static std::map<stage_key_t, std::weak_ptr<conversion_stage>> _stages;
+
+static void copy_data(encoder_frame* frame, AVFrame* vframe)
+{
+	int h_chroma_shift, v_chroma_shift;
+	av_pix_fmt_get_chroma_sub_sample(static_cast<AVPixelFormat>(vframe->format), &h_chroma_shift, &v_chroma_shift);
+
+	for (std::size_t idx = 0; idx < MAX_AV_PLANES; idx++) {
+		if (!frame->data[idx] || !vframe->data[idx])
+			continue;
+
+		std::size_t plane_height = static_cast<size_t>(vframe->height) >> (idx ? v_chroma_shift : 0);
+		std::size_t ls_in        = static_cast<size_t>(frame->linesize[idx]);
+		std::size_t ls_out       = static_cast<size_t>(vframe->linesize[idx]);
+		std::size_t bytes        = ls_in < ls_out ? ls_in : ls_out;
+		uint8_t*    to           = vframe->data[idx];
+		uint8_t*    from         = frame->data[idx];
+
+		// Copy bands of rows in parallel, as a single thread can't saturate the available memory bandwidth.
+		streamfx::threadpool()->parallel_for(0, plane_height, ST_COPY_ROWS_PER_TASK,
+											 [to, from, ls_in, ls_out, bytes](std::size_t begin, std::size_t end) {
+												 streamfx::util::copy_plane(to + ls_out * begin, ls_out,
+																			from + ls_in * begin, ls_in, bytes,
+																			end - begin);
+											 });
+	}
+}
+
+conversion_stage::conversion_stage(const format& source, const format& target)
+	: _scaler(), _copy(false), _pool(), _lock(), _converted(), _converting(false), _current(), _current_planes(),
+	  _current_pts(0), _current_consumers()
+{
+	_scaler.set_source_size(source.width, source.height);
+	_scaler.set_source_color(source.full_range, source.color_space);
+	_scaler.set_source_format(source.pixel_format);
+
+	_scaler.set_target_size(target.width, target.height);
+	_scaler.set_target_color(target.full_range, target.color_space);
+	_scaler.set_target_format(target.pixel_format);
+
+	// Frames that only differ in memory layout are copied instead.
+	_copy = (source.width == target.width) && (source.height == target.height)
+			&& (source.pixel_format == target.pixel_format) && (source.color_space == target.color_space)
+			&& (source.full_range == target.full_range);
+
+	// Create Scaler, which converts large frames in parallel bands. Only regular workers pick up the bands, with the
+	// calling thread converting one of its own, and there is no point in more bands than cores to run them on.
+	std::size_t bands = streamfx::threadpool()->layout().workers + 1;
+	bands             = std::min<std::size_t>(bands, std::max<unsigned int>(std::thread::hardware_concurrency(), 1));
+	if (!_copy && !_scaler.initialize(SWS_POINT, bands)) {
+		std::stringstream sstr;
+		sstr << "Initializing scaler failed for conversion from '"
+			 << tools::get_pixel_format_name(_scaler.get_source_format()) << "' to '"
+			 << tools::get_pixel_format_name(_scaler.get_target_format()) << "' with color space '"
+			 << tools::get_color_space_name(_scaler.get_source_colorspace()) << "' and "
+			 << (_scaler.is_source_full_range() ? "full" : "partial") << " range.";
+		throw std::runtime_error(sstr.str());
+	}
+
+	_pool = std::make_shared<avframe_pool>(static_cast<int32_t>(target.width), static_cast<int32_t>(target.height),
+										   target.pixel_format, ST_POOL_CAPACITY);
+}
+
+conversion_stage::~conversion_stage()
+{
+	if (_current) {
+		_pool->release(_current);
+		_current.reset();
+	}
+
+	_scaler.finalize();
+}
+
+int conversion_stage::convert(const void* consumer, encoder_frame* frame, std::shared_ptr<AVFrame>& target)
+{
+	// OBS hands the same planes to every encoder that wants the same frame, but recycles them for later frames, so
+	// the planes alone can't tell frames apart. The timestamp does, as every new frame OBS produces gets a new one.
+	// Encoders that skip frames or joined later may see other timestamps for the same frame, which only costs them
+	// the sharing. The last conversion is also never handed twice to the same consumer.
+	auto is_current = [this, consumer, frame]() {
+		return _current && (_current_pts == frame->pts)
+			   && std::equal(_current_planes.begin(), _current_planes.end(), frame->data)
+			   && (std::find(_current_consumers.begin(), _current_consumers.end(), consumer)
+				   == _current_consumers.end());
+	};
+
+	std::unique_lock<std::mutex> lock(_lock);
+
+	// The scaler only converts one frame at a time, which may well be the one we are waiting for.
+	_converted.wait(lock, [this, &is_current]() { return !_converting || is_current(); });
+	if (!is_current()) {
+		// Convert without holding the lock, so that consumers of the current frame don't have to wait for it.
+		_converting = true;
+		lock.unlock();
+
+		auto converted = _pool->acquire();
+		int  res       = 0;
+		if (_copy) {
+			copy_data(frame, converted.get());
+		} else {
+			res = _scaler.convert(reinterpret_cast<uint8_t**>(frame->data), reinterpret_cast<int*>(frame->linesize), 0,
+								  static_cast<int32_t>(_scaler.get_source_height()), converted->data,
+								  converted->linesize);
+		}
+
+		lock.lock();
+		_converting = false;
+		_converted.notify_all();
+		if ((res < 0) || (!_copy && (res == 0))) {
+			_pool->release(converted);
+			return (res < 0) ? res : AVERROR_UNKNOWN;
+		}
+
+		if (_current) {
+			_pool->release(_current);
+		}
+		_current = converted;
+		std::copy(frame->data, frame->data + MAX_AV_PLANES, _current_planes.begin());
+		_current_pts = frame->pts;
+		_current_consumers.clear();
+	}
+	_current_consumers.push_back(consumer);
+
+	target = _pool->reference(_current.get());
+	return target ? 0 : AVERROR(ENOMEM);
+}
+
+swscale& conversion_stage::get_scaler()
+{
+	return _scaler;
+}
+
+std::shared_ptr<avframe_pool> conversion_stage::get_pool()
+{
+	return _pool;
+}
+
+std::shared_ptr<conversion_stage> conversion_stage::get(const format& source, const format& target)
+{
+	stage_key_t key = std::make_tuple(source.width, source.height, source.pixel_format, source.color_space,
+									  source.full_range, target.width, target.height, target.pixel_format,
+									  target.color_space, target.full_range);
+
+	std::unique_lock<std::mutex> lock(_stages_lock);
+	if (auto kv = _stages.find(key); kv != _stages.end()) {
+		if (auto stage = kv->second.lock(); stage) {
+			return stage;
+		}
+		_stages.erase(kv);
+	}
+
+	auto stage = std::make_shared<conversion_stage>(source, target);
+	_stages.emplace(key, stage);
+	return stage;
+}
@@ -0,0 +1,94 @@
+// FFMPEG Video Encoder Integration for OBS Studio
+// Copyright (c) 2021 Michael Fabian Dirks <info@xaymar.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "common.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "avframe-pool.hpp"
+#include "swscale.hpp"
+
+extern "C" {
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4242 4244 4365)
+#endif
+#include <obs-encoder.h>
+#include <libavutil/frame.h>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+}
+
+namespace streamfx::ffmpeg {
+	/** Converts frames from OBS once for every encoder that wants them in the same format.
+	 *
+	 * Encoders that are given the same frame by OBS and ask for the same target format share one stage, and with it
+	 * one conversion per frame. Each encoder receives its own reference to the converted planes, which return to the
+	 * shared frame pool once every encoder is done with them.
+	 */
+	class conversion_stage {
+		public:
+		struct format {
+			uint32_t      width;
+			uint32_t      height;
+			AVPixelFormat pixel_format;
+			AVColorSpace  color_space;
+			bool          full_range;
+		};
+
+		private:
+		swscale                       _scaler;
+		bool                          _copy;
+		std::shared_ptr<avframe_pool> _pool;
+
+		std::mutex                                _lock;
+		std::condition_variable                   _converted;
+		bool                                      _converting;
+		std::shared_ptr<AVFrame>                  _current;
+		std::array<const uint8_t*, MAX_AV_PLANES> _current_planes;
+		int64_t                                   _current_pts;
+		std::vector<const void*>                  _current_consumers;
+
+		public:
+		conversion_stage(const format& source, const format& target);
+		~conversion_stage();
+
+		/** Convert a frame from OBS, or reuse the conversion another consumer already asked for.
+		 *
+		 * @param consumer Identifies the caller, so that a consumer asking twice for the same planes is given a fresh
+		 *                 conversion of whatever OBS placed there since.
+		 * @param target Receives a new reference to the converted frame, which should be released to get_pool().
+		 * @return 0 on success, otherwise an FFmpeg error code.
+		 */
+		int convert(const void* consumer, encoder_frame* frame, std::shared_ptr<AVFrame>& target);
+
+		swscale& get_scaler();
+
+		std::shared_ptr<avframe_pool> get_pool();
+
+		public:
+		/** Retrieve the stage for a conversion, creating it if nobody else is using it yet.
+		 */
+		static std::shared_ptr<conversion_stage> get(const format& source, const format& target);
+	};
+} // namespace streamfx::ffmpeg
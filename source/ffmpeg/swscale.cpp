@@ -20,10 +20,66 @@
 // SOFTWARE.
 
 #include "swscale.hpp"
+#include <algorithm>
+#include <atomic>
 #include <stdexcept>
+#include "plugin.hpp"
+#include "util/util-threadpool.hpp"
+
+extern "C" {
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4242 4244 4365)
+#endif
+#include <libavutil/pixdesc.h>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+}
+
+// Bands start on a multiple of this many rows, which keeps chroma subsampling and the ordered dither pattern aligned
+// with the rows of the full image.
+#define ST_SLICE_ALIGNMENT 8
+
+// Smallest band worth handing to another thread.
+#define ST_SLICE_MINIMUM_ROWS 64
 
 using namespace streamfx::ffmpeg;
 
+static SwsContext* create_context(int source_width, int source_height, AVPixelFormat source_format,
+								  bool source_full_range, AVColorSpace source_colorspace, int target_width,
+								  int target_height, AVPixelFormat target_format, bool target_full_range,
+								  AVColorSpace target_colorspace, int flags)
+{
+	SwsContext* context = sws_getContext(source_width, source_height, source_format, target_width, target_height,
+										 target_format, flags, nullptr, nullptr, nullptr);
+	if (!context) {
+		return nullptr;
+	}
+
+	sws_setColorspaceDetails(context, sws_getCoefficients(source_colorspace), source_full_range ? 1 : 0,
+							 sws_getCoefficients(target_colorspace), target_full_range ? 1 : 0, 1L << 16 | 0L,
+							 1L << 16 | 0L, 1L << 16 | 0L);
+	return context;
+}
+
+// Offset all planes of an image to the given row of the full image.
+template<typename T>
+static void offset_planes(T* const data[], const int stride[], AVPixelFormat format, int32_t row, T* planes[4])
+{
+	const AVPixFmtDescriptor* desc  = av_pix_fmt_desc_get(format);
+	int                       count = av_pix_fmt_count_planes(format);
+	for (int plane = 0; plane < 4; plane++) {
+		if ((plane >= count) || !data[plane]) {
+			planes[plane] = nullptr;
+			continue;
+		}
+
+		int32_t plane_row = ((plane == 1) || (plane == 2)) ? (row >> desc->log2_chroma_h) : row;
+		planes[plane]     = data[plane] + static_cast<ptrdiff_t>(stride[plane]) * plane_row;
+	}
+}
+
 swscale::swscale() {}
 
 swscale::~swscale()
@@ -157,7 +213,7 @@ bool swscale::is_target_full_range()
 	return this->target_full_range;
 }
 
-bool swscale::initialize(int flags)
+bool swscale::initialize(int flags, std::size_t threads)
 {
 	if (this->context) {
 		return false;
@@ -171,23 +227,52 @@ bool swscale::initialize(int flags)
 		throw std::invalid_argument("not all target parameters were set");
 	}
 
-	this->context =
-		sws_getContext(static_cast<int>(source_size.first), static_cast<int>(source_size.second), source_format,
-					   static_cast<int>(target_size.first), static_cast<int>(target_size.second), target_format, flags,
-					   nullptr, nullptr, nullptr);
+	this->context = create_context(static_cast<int>(source_size.first), static_cast<int>(source_size.second),
+								   source_format, source_full_range, source_colorspace,
+								   static_cast<int>(target_size.first), static_cast<int>(target_size.second),
+								   target_format, target_full_range, target_colorspace, flags);
 	if (!this->context) {
 		return false;
 	}
 
-	sws_setColorspaceDetails(this->context, sws_getCoefficients(source_colorspace), source_full_range ? 1 : 0,
-							 sws_getCoefficients(target_colorspace), target_full_range ? 1 : 0, 1L << 16 | 0L,
-							 1L << 16 | 0L, 1L << 16 | 0L);
+	// Split the image into bands, if each band can be converted on its own with the exact same result. Point sampling
+	// without vertical scaling never looks at rows outside of the band. Chroma must not be resampled vertically either,
+	// as where those rows are sampled from depends on the height of the whole image.
+	int32_t height        = static_cast<int32_t>(source_size.second);
+	bool    same_chroma_h = av_pix_fmt_desc_get(source_format)->log2_chroma_h
+						 == av_pix_fmt_desc_get(target_format)->log2_chroma_h;
+	if ((threads > 1) && ((flags & SWS_POINT) != 0) && (source_size.second == target_size.second) && same_chroma_h) {
+		int32_t rows = static_cast<int32_t>((source_size.second + threads - 1) / threads);
+		rows         = std::max(rows, ST_SLICE_MINIMUM_ROWS);
+		rows         = (rows + ST_SLICE_ALIGNMENT - 1) / ST_SLICE_ALIGNMENT * ST_SLICE_ALIGNMENT;
+
+		for (int32_t row = 0; (row < height) && (rows < height); row += rows) {
+			int32_t     band_rows = std::min(rows, height - row);
+			SwsContext* band =
+				create_context(static_cast<int>(source_size.first), band_rows, source_format, source_full_range,
+							   source_colorspace, static_cast<int>(target_size.first), band_rows, target_format,
+							   target_full_range, target_colorspace, flags);
+			if (!band) { // Fall back to converting the whole image at once.
+				for (auto& slice : this->slices) {
+					sws_freeContext(slice.context);
+				}
+				this->slices.clear();
+				break;
+			}
+			this->slices.push_back({band, row, band_rows});
+		}
+	}
 
 	return true;
 }
 
 bool swscale::finalize()
 {
+	for (auto& slice : this->slices) {
+		sws_freeContext(slice.context);
+	}
+	this->slices.clear();
+
 	if (this->context) {
 		sws_freeContext(this->context);
 		this->context = nullptr;
@@ -196,12 +281,44 @@ bool swscale::finalize()
 	return false;
 }
 
+std::size_t swscale::get_slices()
+{
+	return std::max<std::size_t>(this->slices.size(), 1);
+}
+
 int32_t swscale::convert(const uint8_t* const source_data[], const int source_stride[], int32_t source_row,
 						 int32_t source_rows, uint8_t* const target_data[], const int target_stride[])
 {
 	if (!this->context) {
 		return 0;
 	}
+
+	// Convert full images in bands, if possible.
+	if ((this->slices.size() > 1) && (source_row == 0)
+		&& (source_rows == static_cast<int32_t>(this->source_size.second))) {
+		std::atomic<int32_t> height{0};
+		std::atomic<int32_t> error{1};
+		streamfx::threadpool()->parallel_for(
+			0, this->slices.size(), 1, [&](std::size_t begin, std::size_t end) {
+				for (std::size_t idx = begin; idx < end; idx++) {
+					auto&          slice = this->slices[idx];
+					const uint8_t* source_planes[4];
+					uint8_t*       target_planes[4];
+					offset_planes(source_data, source_stride, this->source_format, slice.row, source_planes);
+					offset_planes(target_data, target_stride, this->target_format, slice.row, target_planes);
+
+					int res = sws_scale(slice.context, source_planes, source_stride, 0, slice.rows, target_planes,
+										target_stride);
+					if (res > 0) {
+						height.fetch_add(res);
+					} else {
+						error.store(res);
+					}
+				}
+			});
+		return (error.load() <= 0) ? error.load() : height.load();
+	}
+
 	int height =
 		sws_scale(this->context, source_data, source_stride, source_row, source_rows, target_data, target_stride);
 	return height;
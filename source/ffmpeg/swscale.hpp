@@ -22,6 +22,7 @@
 #pragma once
 #include "common.hpp"
 #include <utility>
+#include <vector>
 
 extern "C" {
 #ifdef _MSC_VER
@@ -49,6 +50,14 @@ namespace streamfx::ffmpeg {
 
 		SwsContext* context = nullptr;
 
+		// Horizontal bands that are converted in parallel, each with its own context.
+		struct slice {
+			SwsContext* context;
+			int32_t     row;
+			int32_t     rows;
+		};
+		std::vector<slice> slices;
+
 		public:
 		swscale();
 		~swscale();
@@ -79,9 +88,19 @@ namespace streamfx::ffmpeg {
 		void                          set_target_full_range(bool full_range);
 		bool                          is_target_full_range();
 
-		bool initialize(int flags);
+		/** Create the conversion context.
+		 *
+		 * @param threads Maximum number of bands to convert in parallel. Only used if the conversion can be split into
+		 *                bands without changing the result, which requires point sampling, no vertical scaling, and
+		 *                the same vertical chroma subsampling on both sides.
+		 */
+		bool initialize(int flags, std::size_t threads = 1);
 		bool finalize();
 
+		/** Number of bands a full image is converted in.
+		 */
+		std::size_t get_slices();
+
 		int32_t convert(const uint8_t* const source_data[], const int source_stride[], int32_t source_row,
 						int32_t source_rows, uint8_t* const target_data[], const int target_stride[]);
 	};
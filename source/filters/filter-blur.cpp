@@ -405,17 +405,13 @@ void blur_instance::video_render(gs_effect_t* effect)
 		return;
 	}
 
-#ifdef ENABLE_PROFILING
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "Blur '%s'",
 										 obs_source_get_name(_self)};
-#endif
 
 	if (!_source_rendered) {
 		// Source To Texture
 		{
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_cache, "Cache"};
-#endif
 
 			if (obs_source_process_filter_begin(this->_self, GS_RGBA, OBS_ALLOW_DIRECT_RENDERING)) {
 				{
@@ -463,9 +459,7 @@ void blur_instance::video_render(gs_effect_t* effect)
 
 	if (!_output_rendered) {
 		{
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Blur"};
-#endif
 
 			_blur->set_input(_source_texture);
 			_output_texture = _blur->render();
@@ -473,9 +467,7 @@ void blur_instance::video_render(gs_effect_t* effect)
 
 		// Mask
 		if (_mask.enabled) {
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Mask"};
-#endif
 
 			gs_blend_state_push();
 			gs_reset_blend_state();
@@ -531,10 +523,8 @@ void blur_instance::video_render(gs_effect_t* effect)
 					}
 				}
 
-#ifdef ENABLE_PROFILING
 				streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_capture, "Capture '%s'",
 													obs_source_get_name(_mask.source.source_texture->get_object())};
-#endif
 
 				this->_mask.source.texture = this->_mask.source.source_texture->render(source_width, source_height);
 			}
@@ -567,9 +557,7 @@ void blur_instance::video_render(gs_effect_t* effect)
 
 	// Draw source
 	{
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_render, "Render"};
-#endif
 
 		// It is important that we do not modify the blend state here, as it is set correctly by OBS
 		gs_set_cull_mode(GS_NEITHER);
@@ -298,9 +298,7 @@ void color_grade_instance::prepare_effect()
 
 void color_grade_instance::rebuild_lut()
 {
-#ifdef ENABLE_PROFILING
 	streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_cache, "Rebuild LUT"};
-#endif
 
 	// Generate a fresh LUT texture.
 	auto lut_texture = _lut_producer->produce(_lut_depth);
@@ -372,20 +370,16 @@ void color_grade_instance::video_render(gs_effect_t* shader)
 		return;
 	}
 
-#ifdef ENABLE_PROFILING
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "Color Grading '%s'",
 										 obs_source_get_name(_self)};
-#endif
 
 	// TODO: Optimize this once (https://github.com/obsproject/obs-studio/pull/4199) is merged.
 	// - We can skip the original capture and reduce the overall impact of this.
 
 	// 1. Capture the filter/source rendered above this.
 	if (!_ccache_fresh || !_ccache_texture) {
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_cache, "Cache '%s'",
 											 obs_source_get_name(target)};
-#endif
 		// If the input cache render target doesn't exist, create it.
 		if (!_ccache_rt) {
 			_ccache_rt = std::make_shared<streamfx::obs::gs::rendertarget>(GS_RGBA, GS_ZS_NONE);
@@ -438,9 +432,7 @@ void color_grade_instance::video_render(gs_effect_t* shader)
 	// 2. Apply one of the two rendering methods (LUT or Direct).
 	if (_lut_initialized && _lut_enabled) { // Try to apply with the LUT based method.
 		try {
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "LUT Rendering"};
-#endif
 			// If the LUT was changed, rebuild the LUT first.
 			if (_lut_dirty) {
 				rebuild_lut();
@@ -504,9 +496,7 @@ void color_grade_instance::video_render(gs_effect_t* shader)
 		}
 	}
 	if ((!_lut_initialized || !_lut_enabled) && !_cache_fresh) {
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Direct Rendering"};
-#endif
 		// Reallocate the rendertarget if necessary.
 		if (_cache_rt->get_color_format() != GS_RGBA) {
 			allocate_rendertarget(GS_RGBA);
@@ -560,9 +550,7 @@ void color_grade_instance::video_render(gs_effect_t* shader)
 
 	// 3. Render the output cache.
 	{
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_cache_render, "Draw Cache"};
-#endif
 		// Revert GPU status to what OBS Studio expects.
 		gs_enable_depth_test(false);
 		gs_enable_color(true, true, true, true);
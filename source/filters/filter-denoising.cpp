@@ -243,11 +243,9 @@ void denoising_instance::video_render(gs_effect_t* effect)
 		return;
 	}
 
-#ifdef ENABLE_PROFILING
 	::streamfx::obs::gs::debug_marker profiler0{::streamfx::obs::gs::debug_color_source, "StreamFX Denoising"};
 	::streamfx::obs::gs::debug_marker profiler0_0{::streamfx::obs::gs::debug_color_gray, "'%s' on '%s'",
 												  obs_source_get_name(_self), obs_source_get_name(parent)};
-#endif
 
 	if (_dirty) { // Lock the provider from being changed.
 		std::unique_lock<std::mutex> ul(_provider_lock);
@@ -266,9 +264,7 @@ void denoising_instance::video_render(gs_effect_t* effect)
 		}
 
 		{ // Capture the incoming frame.
-#ifdef ENABLE_PROFILING
 			::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_capture, "Capture"};
-#endif
 			if (obs_source_process_filter_begin(_self, GS_RGBA, OBS_ALLOW_DIRECT_RENDERING)) {
 				auto op = _input->render(_size.first, _size.second);
 
@@ -288,9 +284,7 @@ void denoising_instance::video_render(gs_effect_t* effect)
 				gs_set_cull_mode(GS_NEITHER);
 
 				// Render
-#ifdef ENABLE_PROFILING
 				::streamfx::obs::gs::debug_marker profiler2{::streamfx::obs::gs::debug_color_capture, "Storage"};
-#endif
 				obs_source_process_filter_end(_self, obs_get_base_effect(OBS_EFFECT_DEFAULT), 1, 1);
 
 				// Reset GPU state
@@ -303,9 +297,7 @@ void denoising_instance::video_render(gs_effect_t* effect)
 		}
 
 		try { // Process the captured input with the provider.
-#ifdef ENABLE_PROFILING
 			::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_convert, "Process"};
-#endif
 			switch (_provider) {
 #ifdef ENABLE_FILTER_DENOISING_NVIDIA
 			case denoising_provider::NVIDIA_DENOISING:
@@ -334,9 +326,7 @@ void denoising_instance::video_render(gs_effect_t* effect)
 	}
 
 	{ // Draw the result for the next filter to use.
-#ifdef ENABLE_PROFILING
 		::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_render, "Render"};
-#endif
 		if (_standard_effect->has_parameter("Channel0", ::streamfx::obs::gs::effect_parameter::type::Texture)) {
 			_standard_effect->get_parameter("Channel0").set_texture(_output);
 		}
@@ -380,9 +370,10 @@ void streamfx::filter::denoising::denoising_instance::switch_provider(denoising_
 	spd->provider = _provider;
 	_provider     = provider;
 
-	// 3. Then spawn a new task to switch provider.
+	// 3. Then spawn a new task to switch provider, which loads models and may take a while.
 	_provider_task = streamfx::threadpool()->push(
-		std::bind(&denoising_instance::task_switch_provider, this, std::placeholders::_1), spd);
+		std::bind(&denoising_instance::task_switch_provider, this, std::placeholders::_1), spd,
+		util::threadpool_priority::BACKGROUND, util::threadpool_deadline_t::max(), "Denoising Provider");
 }
 
 void streamfx::filter::denoising::denoising_instance::task_switch_provider(util::threadpool_data_t data)
@@ -75,17 +75,15 @@ face_tracking_instance::face_tracking_instance(obs_data_t* settings, obs_source_
 	  _ar_bboxes_confidence(), _ar_bboxes_data(), _ar_bboxes(), _ar_texture(), _ar_texture_cuda_fresh(false),
 	  _ar_texture_cuda(), _ar_texture_cuda_mem(), _ar_image(), _ar_image_bgr(), _ar_image_temp()
 {
-#ifdef ENABLE_PROFILING
-	// Profiling
-	_profile_capture         = streamfx::util::profiler::create();
-	_profile_capture_realloc = streamfx::util::profiler::create();
-	_profile_capture_copy    = streamfx::util::profiler::create();
-	_profile_ar_realloc      = streamfx::util::profiler::create();
-	_profile_ar_copy         = streamfx::util::profiler::create();
-	_profile_ar_transfer     = streamfx::util::profiler::create();
-	_profile_ar_run          = streamfx::util::profiler::create();
-	_profile_ar_calc         = streamfx::util::profiler::create();
-#endif
+	// Profiling, shared by all instances.
+	_profile_capture         = streamfx::util::profiler::create("Face Tracking Capture");
+	_profile_capture_realloc = streamfx::util::profiler::create("Face Tracking Capture Reallocate");
+	_profile_capture_copy    = streamfx::util::profiler::create("Face Tracking Capture Copy");
+	_profile_ar_realloc      = streamfx::util::profiler::create("Face Tracking AR Reallocate");
+	_profile_ar_copy         = streamfx::util::profiler::create("Face Tracking AR Copy");
+	_profile_ar_transfer     = streamfx::util::profiler::create("Face Tracking AR Convert");
+	_profile_ar_run          = streamfx::util::profiler::create("Face Tracking AR Run");
+	_profile_ar_calc         = streamfx::util::profiler::create("Face Tracking AR Calculate");
 
 	{ // Create render target, vertex buffer, and CUDA stream.
 		auto gctx = streamfx::obs::gs::context{};
@@ -141,7 +139,9 @@ void face_tracking_instance::async_initialize(std::shared_ptr<void> ptr)
 		}
 
 		_async_initialize = streamfx::threadpool()->push(
-			std::bind(&face_tracking_instance::async_initialize, this, std::placeholders::_1), data);
+			std::bind(&face_tracking_instance::async_initialize, this, std::placeholders::_1), data,
+			::streamfx::util::threadpool_priority::BACKGROUND, ::streamfx::util::threadpool_deadline_t::max(),
+			"Face Tracking Initialize");
 	} else {
 		std::shared_ptr<async_data> data = std::static_pointer_cast<async_data>(ptr);
 
@@ -230,9 +230,7 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 		if (_ar_is_tracking)
 			return; // Can't track a new frame right now.
 
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Start Asynchronous Tracking"};
-#endif
 
 		// Don't push additional tracking frames while processing one.
 		_ar_is_tracking = true;
@@ -244,10 +242,8 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 
 		// Check if things exist as planned.
 		if (!_ar_texture || (_ar_texture->get_width() != _size.first) || (_ar_texture->get_height() != _size.second)) {
-#ifdef ENABLE_PROFILING
 			auto                            prof = _profile_capture_realloc->track();
 			streamfx::obs::gs::debug_marker marker{streamfx::obs::gs::debug_color_allocate, "Reallocate GPU Buffer"};
-#endif
 			_ar_texture =
 				std::make_shared<streamfx::obs::gs::texture>(_size.first, _size.second, GS_RGBA_UNORM, uint32_t(1),
 															 nullptr, streamfx::obs::gs::texture::flags::None);
@@ -255,17 +251,17 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 		}
 
 		{ // Copy texture
-#ifdef ENABLE_PROFILING
 			auto                            prof = _profile_capture_copy->track();
 			streamfx::obs::gs::debug_marker marker{streamfx::obs::gs::debug_color_copy, "Copy Capture",
 												   obs_source_get_name(_self)};
-#endif
 			gs_copy_texture(_ar_texture->get_object(), _rt->get_texture()->get_object());
 		}
 
 		// Push work
 		_async_track = streamfx::threadpool()->push(
-			std::bind(&face_tracking_instance::async_track, this, std::placeholders::_1), data);
+			std::bind(&face_tracking_instance::async_track, this, std::placeholders::_1), data,
+			::streamfx::util::threadpool_priority::REALTIME, ::streamfx::util::threadpool_deadline_t::max(),
+			"Face Tracking");
 	} else {
 		// Prevent conflicts.
 		std::unique_lock<std::mutex> alk{_ar_lock};
@@ -288,11 +284,9 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 
 		// Refresh any now broken buffers.
 		if (!_ar_texture_cuda_fresh) {
-#ifdef ENABLE_PROFILING
 			auto                            prof = _profile_ar_realloc->track();
 			streamfx::obs::gs::debug_marker marker{streamfx::obs::gs::debug_color_allocate,
 												   "%s: Reallocate CUDA Buffers", obs_source_get_name(_self)};
-#endif
 			// Assign new texture and allocate new memory.
 			std::size_t pitch = _ar_texture->get_width() * 4ul;
 			_ar_texture_cuda  = std::make_shared<::streamfx::nvidia::cuda::gstexture>(_ar_texture);
@@ -334,9 +328,7 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 		}
 
 		{ // Copy from CUDA array to CUDA device memory.
-#ifdef ENABLE_PROFILING
 			auto prof = _profile_ar_copy->track();
-#endif
 			::streamfx::nvidia::cuda::memcpy2d_v2_t mc;
 			mc.src_x_in_bytes  = 0;
 			mc.src_y           = 0;
@@ -363,9 +355,7 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 		}
 
 		{ // Convert from RGBA 32-bit to BGR 24-bit.
-#ifdef ENABLE_PROFILING
 			auto prof = _profile_ar_transfer->track();
-#endif
 			if (NvCV_Status res =
 					_ar_library->image_transfer(&_ar_image, &_ar_image_bgr, 1.0,
 												reinterpret_cast<CUstream_st*>(_cuda_stream->get()), &_ar_image_temp);
@@ -380,9 +370,7 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 		}
 
 		{ // Track any faces.
-#ifdef ENABLE_PROFILING
 			auto prof = _profile_ar_run->track();
-#endif
 			if (NvCV_Status res = _ar_library->run(_ar_feature.get()); res != NVCV_SUCCESS) {
 				DLOG_ERROR("<%s> Failed to run tracking.", obs_source_get_name(_self));
 				return;
@@ -401,9 +389,7 @@ void face_tracking_instance::async_track(std::shared_ptr<void> ptr)
 			_values.velocity[1] = 0;
 		} else {
 			// If yes, begin tracking.
-#ifdef ENABLE_PROFILING
 			auto prof = _profile_ar_calc->track();
-#endif
 
 			double_t sx     = static_cast<double_t>(_ar_image_bgr.width);
 			double_t sy     = static_cast<double_t>(_ar_image_bgr.height);
@@ -555,22 +541,16 @@ void face_tracking_instance::video_render(gs_effect_t*)
 		return;
 	}
 
-#ifdef ENABLE_PROFILING
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "NVIDIA Face Tracking '%s'...",
 										 obs_source_get_name(_self)};
 	streamfx::obs::gs::debug_marker gdmp2{streamfx::obs::gs::debug_color_source, "... on '%s'",
 										  obs_source_get_name(obs_filter_get_parent(_self))};
-#endif
 
 	if (!_rt_is_fresh) { // Capture the filter stack "below" us.
-#ifdef ENABLE_PROFILING
 		auto prof = _profile_capture->track();
-#endif
 
 		{
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_cache, "Cache"};
-#endif
 
 			if (obs_source_process_filter_begin(_self, GS_RGBA, OBS_NO_DIRECT_RENDERING)) {
 				auto op  = _rt->render(_size.first, _size.second);
@@ -597,9 +577,7 @@ void face_tracking_instance::video_render(gs_effect_t*)
 	}
 
 	{ // Draw Texture
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_render, "Render"};
-#endif
 
 		gs_effect_set_texture(gs_effect_get_param_by_name(default_effect, "image"), _rt->get_texture()->get_object());
 		gs_load_vertexbuffer(_geometry->update(false));
@@ -610,7 +588,6 @@ void face_tracking_instance::video_render(gs_effect_t*)
 	}
 }
 
-#ifdef ENABLE_PROFILING
 bool face_tracking_instance::button_profile(obs_properties_t* props, obs_property_t* property)
 {
 	DLOG_INFO("%-22s: %-10s %-10s %-10s %-10s %-10s", "Task", "Total", "Count", "Average", "99.9%ile", "95.0%ile");
@@ -631,7 +608,6 @@ bool face_tracking_instance::button_profile(obs_properties_t* props, obs_propert
 
 	return false;
 }
-#endif
 
 face_tracking_factory::face_tracking_factory()
 {
@@ -699,8 +675,7 @@ obs_properties_t* face_tracking_factory::get_properties2(face_tracking_instance*
 			}
 		}
 	}
-#ifdef ENABLE_PROFILING
-	{
+	if (streamfx::util::profiler::is_enabled()) {
 		obs_properties_add_button2(
 			pr, "Profile", "Profile",
 			[](obs_properties_t* props, obs_property_t* property, void* data) {
@@ -708,7 +683,6 @@ obs_properties_t* face_tracking_factory::get_properties2(face_tracking_instance*
 			},
 			data);
 	}
-#endif
 
 	return pr;
 }
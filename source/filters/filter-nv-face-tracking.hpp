@@ -87,7 +87,6 @@ namespace streamfx::filter::nvidia {
 		std::shared_ptr<::streamfx::util::threadpool::task> _async_initialize;
 		std::shared_ptr<::streamfx::util::threadpool::task> _async_track;
 
-#ifdef ENABLE_PROFILING
 		// Profiling
 		std::shared_ptr<streamfx::util::profiler> _profile_capture;
 		std::shared_ptr<streamfx::util::profiler> _profile_capture_realloc;
@@ -97,7 +96,6 @@ namespace streamfx::filter::nvidia {
 		std::shared_ptr<streamfx::util::profiler> _profile_ar_transfer;
 		std::shared_ptr<streamfx::util::profiler> _profile_ar_run;
 		std::shared_ptr<streamfx::util::profiler> _profile_ar_calc;
-#endif
 
 		public:
 		face_tracking_instance(obs_data_t*, obs_source_t*);
@@ -122,9 +120,7 @@ namespace streamfx::filter::nvidia {
 
 		virtual void video_render(gs_effect_t* effect) override;
 
-#ifdef ENABLE_PROFILING
 		bool button_profile(obs_properties_t* props, obs_property_t* property);
-#endif
 	};
 
 	class face_tracking_factory
@@ -326,10 +326,8 @@ void sdf_effects_instance::video_render(gs_effect_t* effect)
 		return;
 	}
 
-#ifdef ENABLE_PROFILING
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "SDF Effects '%s' on '%s'",
 										 obs_source_get_name(_self), obs_source_get_name(obs_filter_get_parent(_self))};
-#endif
 
 	auto gctx              = streamfx::obs::gs::context();
 	vec4 color_transparent = {0, 0, 0, 0};
@@ -352,9 +350,7 @@ void sdf_effects_instance::video_render(gs_effect_t* effect)
 		if (!_source_rendered) {
 			// Store input texture.
 			{
-#ifdef ENABLE_PROFILING
 				streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_cache, "Cache"};
-#endif
 
 				auto op = _source_rt->render(baseW, baseH);
 				gs_ortho(0, static_cast<float>(baseW), 0, static_cast<float>(baseH), -1, 1);
@@ -394,10 +390,8 @@ void sdf_effects_instance::video_render(gs_effect_t* effect)
 				}
 
 				{
-#ifdef ENABLE_PROFILING
 					streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert,
 														"Update Distance Field"};
-#endif
 
 					auto op = _sdf_write->render(uint32_t(sdfW), uint32_t(sdfH));
 					gs_ortho(0, 1, 0, 1, -1, 1);
@@ -453,9 +447,7 @@ void sdf_effects_instance::video_render(gs_effect_t* effect)
 
 		// Optimized Render path.
 		try {
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Calculate"};
-#endif
 
 			auto op = _output_rt->render(baseW, baseH);
 			gs_ortho(0, 1, 0, 1, 0, 1);
@@ -550,9 +542,7 @@ void sdf_effects_instance::video_render(gs_effect_t* effect)
 	}
 
 	{
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_render, "Render"};
-#endif
 
 		gs_eparam_t* ep = gs_effect_get_param_by_name(final_effect, "image");
 		if (ep) {
@@ -103,16 +103,12 @@ void shader_instance::video_render(gs_effect_t* effect)
 			throw std::runtime_error("No effect, or invalid base size.");
 		}
 
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "Shader Filter '%s' on '%s'",
 											 obs_source_get_name(_self),
 											 obs_source_get_name(obs_filter_get_parent(_self))};
-#endif
 
 		{
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_source, "Cache"};
-#endif
 
 			auto op = _rt->render(_fx->base_width(), _fx->base_height());
 
@@ -139,9 +135,7 @@ void shader_instance::video_render(gs_effect_t* effect)
 		}
 
 		{
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_render, "Render"};
-#endif
 
 			_fx->prepare_render();
 			_fx->set_input_a(_rt->get_texture());
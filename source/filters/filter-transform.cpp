@@ -310,10 +310,8 @@ void transform_instance::video_render(gs_effect_t* effect)
 		return;
 	}
 
-#ifdef ENABLE_PROFILING
 	streamfx::obs::gs::debug_marker gdmp{streamfx::obs::gs::debug_color_source, "3D Transform '%s' on '%s'",
 										 obs_source_get_name(_self), obs_source_get_name(obs_filter_get_parent(_self))};
-#endif
 
 	uint32_t cache_width  = base_width;
 	uint32_t cache_height = base_height;
@@ -338,9 +336,7 @@ void transform_instance::video_render(gs_effect_t* effect)
 	}
 
 	if (!_cache_rendered) {
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_cache, "Cache"};
-#endif
 
 		auto op = _cache_rt->render(cache_width, cache_height);
 
@@ -378,15 +374,11 @@ void transform_instance::video_render(gs_effect_t* effect)
 	}
 
 	if (_mipmap_enabled) {
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Mipmap"};
-#endif
 
 		if (!_mipmap_texture || (_mipmap_texture->get_width() != cache_width)
 			|| (_mipmap_texture->get_height() != cache_height)) {
-#ifdef ENABLE_PROFILING
 			streamfx::obs::gs::debug_marker gdr{streamfx::obs::gs::debug_color_allocate, "Allocate Mipmapped Texture"};
-#endif
 
 			std::size_t mip_levels = std::max(streamfx::util::math::get_power_of_two_exponent_ceil(cache_width),
 											  streamfx::util::math::get_power_of_two_exponent_ceil(cache_height));
@@ -404,9 +396,7 @@ void transform_instance::video_render(gs_effect_t* effect)
 	}
 
 	{
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_convert, "Transform"};
-#endif
 
 		auto op = _source_rt->render(base_width, base_height);
 
@@ -452,9 +442,7 @@ void transform_instance::video_render(gs_effect_t* effect)
 	}
 
 	{
-#ifdef ENABLE_PROFILING
 		streamfx::obs::gs::debug_marker gdm{streamfx::obs::gs::debug_color_render, "Render"};
-#endif
 
 		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), _source_texture->get_object());
 		while (gs_effect_loop(effect, "Draw")) {
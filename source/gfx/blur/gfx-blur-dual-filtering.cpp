@@ -227,9 +227,7 @@ std::shared_ptr<::streamfx::obs::gs::texture> streamfx::gfx::blur::dual_filterin
 {
 	auto gctx = streamfx::obs::gs::context();
 
-#ifdef ENABLE_PROFILING
 	auto gdmp = streamfx::obs::gs::debug_marker(streamfx::obs::gs::debug_color_azure_radiance, "Dual-Filtering Blur");
-#endif
 
 	auto effect = _data->get_effect();
 	if (!effect) {
@@ -255,9 +253,7 @@ std::shared_ptr<::streamfx::obs::gs::texture> streamfx::gfx::blur::dual_filterin
 
 	// Downsample
 	for (std::size_t n = 1; n <= iterations; n++) {
-#ifdef ENABLE_PROFILING
 		auto gdm = streamfx::obs::gs::debug_marker(streamfx::obs::gs::debug_color_azure_radiance, "Down %" PRIuMAX, n);
-#endif
 
 		// Select Texture
 		std::shared_ptr<streamfx::obs::gs::texture> tex;
@@ -291,9 +287,7 @@ std::shared_ptr<::streamfx::obs::gs::texture> streamfx::gfx::blur::dual_filterin
 
 	// Upsample
 	for (std::size_t n = iterations; n > 0; n--) {
-#ifdef ENABLE_PROFILING
 		auto gdm = streamfx::obs::gs::debug_marker(streamfx::obs::gs::debug_color_azure_radiance, "Up %" PRIuMAX, n);
-#endif
 
 		// Select Texture
 		std::shared_ptr<streamfx::obs::gs::texture> tex = _rts[n]->get_texture();
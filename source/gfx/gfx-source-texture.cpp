@@ -121,10 +121,8 @@ std::shared_ptr<streamfx::obs::gs::texture> streamfx::gfx::source_texture::rende
 	}
 
 	if (_child) {
-#ifdef ENABLE_PROFILING
 		auto cctr = streamfx::obs::gs::debug_marker(streamfx::obs::gs::debug_color_capture, "gfx::source_texture '%s'",
 													obs_source_get_name(_child->get()));
-#endif
 		auto op = _rt->render(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
 		vec4 black;
 		vec4_zero(&black);
@@ -42,10 +42,31 @@
 #define ST_I18N_PARAMETERS ST_I18N ".Parameters"
 #define ST_KEY_PARAMETERS "Shader.Parameters"
 
+// How often the shader file is checked for changes.
+#define ST_SHADER_FILE_WATCH_INTERVAL std::chrono::milliseconds(333)
+
+static void watch_shader_file(streamfx::util::threadpool_data_t data)
+try {
+	auto watch = std::static_pointer_cast<streamfx::gfx::shader::shader_file_watch>(data);
+
+	std::unique_lock<std::mutex> lock(watch->lock);
+	if (watch->file.empty() || !std::filesystem::exists(watch->file))
+		return;
+
+	if ((std::filesystem::last_write_time(watch->file) != watch->file_mt)
+		|| (std::filesystem::file_size(watch->file) != watch->file_sz)) {
+		watch->changed = true;
+	}
+} catch (...) {
+	// The file is likely being written to right now, try again on the next run.
+}
+
 streamfx::gfx::shader::shader::shader(obs_source_t* self, shader_mode mode)
 	: _self(self), _mode(mode), _base_width(1), _base_height(1), _active(true),
 
-	  _shader(), _shader_file(), _shader_tech("Draw"), _shader_file_mt(), _shader_file_sz(), _shader_file_tick(0),
+	  _shader(), _shader_file(), _shader_tech("Draw"), _shader_file_mt(), _shader_file_sz(), _shader_params(),
+
+	  _shader_file_watch(std::make_shared<shader_file_watch>()), _shader_file_watch_task(),
 
 	  _width_type(size_type::Percent), _width_value(1.0), _height_type(size_type::Percent), _height_value(1.0),
 
@@ -59,9 +80,17 @@ streamfx::gfx::shader::shader::shader(obs_source_t* self, shader_mode mode)
 		_random_values[idx] =
 			static_cast<float_t>(static_cast<double_t>(_random()) / static_cast<double_t>(_random.max()));
 	}
+
+	// Check the shader file for changes outside of the render thread.
+	_shader_file_watch_task = streamfx::threadpool()->schedule_every(
+		watch_shader_file, _shader_file_watch, ST_SHADER_FILE_WATCH_INTERVAL,
+		streamfx::util::threadpool_priority::BACKGROUND, "Shader File Watch");
 }
 
-streamfx::gfx::shader::shader::~shader() {}
+streamfx::gfx::shader::shader::~shader()
+{
+	streamfx::threadpool()->pop(_shader_file_watch_task);
+}
 
 bool streamfx::gfx::shader::shader::is_shader_different(const std::filesystem::path& file)
 try {
@@ -107,11 +136,16 @@ try {
 
 	// Update Shader
 	if (shader_dirty) {
-		_shader           = streamfx::obs::gs::effect(file);
-		_shader_file_mt   = std::filesystem::last_write_time(file);
-		_shader_file_sz   = std::filesystem::file_size(file);
-		_shader_file      = file;
-		_shader_file_tick = 0;
+		_shader         = streamfx::obs::gs::effect(file);
+		_shader_file_mt = std::filesystem::last_write_time(file);
+		_shader_file_sz = std::filesystem::file_size(file);
+		_shader_file    = file;
+
+		std::unique_lock<std::mutex> lock(_shader_file_watch->lock);
+		_shader_file_watch->file    = _shader_file;
+		_shader_file_watch->file_mt = _shader_file_mt;
+		_shader_file_watch->file_sz = _shader_file_sz;
+		_shader_file_watch->changed = false;
 	}
 
 	// Update Params
@@ -437,9 +471,8 @@ uint32_t streamfx::gfx::shader::shader::base_height()
 
 bool streamfx::gfx::shader::shader::tick(float_t time)
 {
-	_shader_file_tick = static_cast<float_t>(static_cast<double_t>(_shader_file_tick) + static_cast<double_t>(time));
-	if (_shader_file_tick >= 1.0f / 3.0f) {
-		_shader_file_tick -= 1.0f / 3.0f;
+	// Reload the shader if the file watch noticed a change.
+	if (_shader_file_watch->changed.exchange(false)) {
 		bool v1, v2;
 		load_shader(_shader_file, _shader_tech, v1, v2);
 	}
@@ -17,9 +17,11 @@
 
 #pragma once
 #include "common.hpp"
+#include <atomic>
 #include <filesystem>
 #include <list>
 #include <map>
+#include <mutex>
 #include <random>
 #include "gfx/shader/gfx-shader-param.hpp"
 #include "obs/gs/gs-effect.hpp"
@@ -40,6 +42,15 @@ namespace streamfx::gfx {
 
 		typedef std::map<std::string_view, std::shared_ptr<parameter>> shader_param_map_t;
 
+		// Shared between a shader and the timer task that checks its file for changes.
+		struct shader_file_watch {
+			std::mutex                      lock;
+			std::filesystem::path           file;
+			std::filesystem::file_time_type file_mt;
+			uintmax_t                       file_sz = 0;
+			std::atomic_bool                changed{false};
+		};
+
 		class shader {
 			obs_source_t* _self;
 
@@ -55,9 +66,11 @@ namespace streamfx::gfx {
 			std::string                     _shader_tech;
 			std::filesystem::file_time_type _shader_file_mt;
 			uintmax_t                       _shader_file_sz;
-			float_t                         _shader_file_tick;
 			shader_param_map_t              _shader_params;
 
+			std::shared_ptr<shader_file_watch>                  _shader_file_watch;
+			std::shared_ptr<::streamfx::util::threadpool::task> _shader_file_watch_task;
+
 			// Options
 			size_type _width_type;
 			double_t  _width_value;
@@ -262,9 +262,7 @@ std::shared_ptr<::streamfx::obs::gs::texture>
 	auto gctx = ::streamfx::obs::gs::context();
 	auto cctx = _nvcuda->get_context()->enter();
 
-#ifdef ENABLE_PROFILING
 	::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_magenta, "NvVFX Super-Resolution"};
-#endif
 
 	// Resize if the size or scale was changed.
 	resize(in->get_width(), in->get_height());
@@ -275,17 +273,13 @@ std::shared_ptr<::streamfx::obs::gs::texture>
 	}
 
 	{ // Copy parameter to input.
-#ifdef ENABLE_PROFILING
 		::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_copy, "Copy In -> Input"};
-#endif
 		gs_copy_texture(_input->get_texture()->get_object(), in->get_object());
 	}
 
 	{ // Convert Input to Source format
-#ifdef ENABLE_PROFILING
 		::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_convert,
 													"Convert Input -> Source"};
-#endif
 		if (auto res = _nvcvi->NvCVImage_Transfer(_input->get_image(), _convert_to_fp32->get_image(), 1.f,
 												  _nvcuda->get_stream()->get(), _tmp->get_image());
 			res != ::streamfx::nvidia::cv::result::SUCCESS) {
@@ -296,9 +290,7 @@ std::shared_ptr<::streamfx::obs::gs::texture>
 	}
 
 	{ // Copy input to source.
-#ifdef ENABLE_PROFILING
 		::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_copy, "Copy Input -> Source"};
-#endif
 		if (auto res = _nvcvi->NvCVImage_Transfer(_convert_to_fp32->get_image(), _source->get_image(), 1.f,
 												  _nvcuda->get_stream()->get(), _tmp->get_image());
 			res != ::streamfx::nvidia::cv::result::SUCCESS) {
@@ -309,9 +301,7 @@ std::shared_ptr<::streamfx::obs::gs::texture>
 	}
 
 	{ // Process source to destination.
-#ifdef ENABLE_PROFILING
 		::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_cache, "Process"};
-#endif
 		if (auto res = _nvvfx->NvVFX_Run(_fx.get(), 0); res != ::streamfx::nvidia::cv::result::SUCCESS) {
 			D_LOG_ERROR("Failed to process due to error: %s", _nvcvi->NvCV_GetErrorStringFromCode(res));
 			throw std::runtime_error("Run failed.");
@@ -319,10 +309,8 @@ std::shared_ptr<::streamfx::obs::gs::texture>
 	}
 
 	{ // Convert Destination to Output format
-#ifdef ENABLE_PROFILING
 		::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_convert,
 													"Convert Destination -> Output"};
-#endif
 		if (auto res = _nvcvi->NvCVImage_Transfer(_destination->get_image(), _convert_to_u8->get_image(), 1.f,
 												  _nvcuda->get_stream()->get(), _tmp->get_image());
 			res != ::streamfx::nvidia::cv::result::SUCCESS) {
@@ -333,10 +321,8 @@ std::shared_ptr<::streamfx::obs::gs::texture>
 	}
 
 	{ // Copy destination to output.
-#ifdef ENABLE_PROFILING
 		::streamfx::obs::gs::debug_marker profiler1{::streamfx::obs::gs::debug_color_copy,
 													"Copy Destination -> Output"};
-#endif
 		if (auto res = _nvcvi->NvCVImage_Transfer(_convert_to_u8->get_image(), _output->get_image(), 1.,
 												  _nvcuda->get_stream()->get(), _tmp->get_image());
 			res != ::streamfx::nvidia::cv::result::SUCCESS) {
@@ -18,3 +18,163 @@
  */
 
 #include "gs-helper.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+static std::shared_ptr<streamfx::obs::gs::gpu_timers> gpu_timers_instance;
+
+streamfx::obs::gs::gpu_timers::gpu_timers()
+	: _frames(), _frame(0), _open(false), _free(), _filters(), _profilers(), _dropped(0)
+{
+	obs_add_main_render_callback(on_frame, this);
+}
+
+streamfx::obs::gs::gpu_timers::~gpu_timers()
+{
+	obs_remove_main_render_callback(on_frame, this);
+
+	streamfx::obs::gs::context gctx;
+	if (_open) {
+		gs_timer_range_end(_frames[_frame].range);
+	}
+	for (auto& frame : _frames) {
+		for (auto& query : frame.queries) {
+			gs_timer_destroy(query.timer);
+		}
+		if (frame.range) {
+			gs_timer_range_destroy(frame.range);
+		}
+	}
+	for (auto timer : _free) {
+		gs_timer_destroy(timer);
+	}
+}
+
+void streamfx::obs::gs::gpu_timers::on_frame(void* ptr, uint32_t, uint32_t) noexcept
+try {
+	auto self = reinterpret_cast<streamfx::obs::gs::gpu_timers*>(ptr);
+
+	// Close the range of the frame that just ended, and read back the oldest one in its place.
+	if (self->_open) {
+		gs_timer_range_end(self->_frames[self->_frame].range);
+		self->_open = false;
+	}
+	self->_frame = (self->_frame + 1) % self->_frames.size();
+
+	auto& frame = self->_frames[self->_frame];
+	self->resolve(frame);
+
+	if (streamfx::util::profiler::is_enabled()) {
+		if (!frame.range) {
+			frame.range = gs_timer_range_create();
+		}
+		if (frame.range) {
+			gs_timer_range_begin(frame.range);
+			self->_open = true;
+		}
+	}
+} catch (...) {
+	DLOG_ERROR("Unexpected exception in function '%s'.", __FUNCTION_NAME__);
+}
+
+void streamfx::obs::gs::gpu_timers::resolve(frame& frame)
+{
+	if (frame.queries.empty()) {
+		return;
+	}
+
+	// Timestamps are only comparable if the GPU clock did not change during the frame.
+	bool     disjoint  = true;
+	uint64_t frequency = 0;
+	bool     valid     = gs_timer_range_get_data(frame.range, &disjoint, &frequency) && !disjoint && (frequency > 0);
+
+	for (auto& query : frame.queries) {
+		uint64_t ticks = 0;
+		if (valid && gs_timer_get_data(query.timer, &ticks)) {
+			query.profiler->track(
+				std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double_t>(ticks) * 1e9 / frequency)));
+		} else {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+		_free.push_back(query.timer);
+	}
+	frame.queries.clear();
+}
+
+// Cut a marker format off before its first argument, so that "Blur '%s'" becomes "Blur".
+static std::string_view marker_name(const char* format)
+{
+	std::string_view name{format};
+	name = name.substr(0, name.find('%'));
+	while (!name.empty() && ((name.back() == ' ') || (name.back() == '\''))) {
+		name.remove_suffix(1);
+	}
+	return name;
+}
+
+gs_timer_t* streamfx::obs::gs::gpu_timers::begin(const float_t color[4], const char* format)
+{
+	if (!_open) {
+		return nullptr;
+	}
+
+	gs_timer_t* timer = nullptr;
+	if (!_free.empty()) {
+		timer = _free.back();
+		_free.pop_back();
+	} else {
+		timer = gs_timer_create();
+	}
+	if (!timer) {
+		return nullptr;
+	}
+
+	const char* filter = _filters.empty() ? nullptr : _filters.back();
+	if (std::equal(color, color + 4, debug_color_source) && (std::strchr(format, '%') != nullptr)) {
+		filter = format;
+	}
+
+	auto profiler = _profilers.find({filter, format});
+	if (profiler == _profilers.end()) {
+		std::string name = "GPU ";
+		if (filter && (filter != format)) {
+			name.append(marker_name(filter)).append(" / ");
+		}
+		name.append(marker_name(format));
+		profiler = _profilers.emplace(scope_t{filter, format}, streamfx::util::profiler::create(name)).first;
+	}
+
+	_filters.push_back(filter);
+	_frames[_frame].queries.push_back({profiler->second, timer});
+	gs_timer_begin(timer);
+	return timer;
+}
+
+void streamfx::obs::gs::gpu_timers::end(gs_timer_t* timer)
+{
+	gs_timer_end(timer);
+	if (!_filters.empty()) {
+		_filters.pop_back();
+	}
+}
+
+uint64_t streamfx::obs::gs::gpu_timers::dropped()
+{
+	return _dropped.load(std::memory_order_relaxed);
+}
+
+void streamfx::obs::gs::gpu_timers::initialize()
+{
+	gpu_timers_instance = std::make_shared<streamfx::obs::gs::gpu_timers>();
+}
+
+void streamfx::obs::gs::gpu_timers::finalize()
+{
+	gpu_timers_instance.reset();
+}
+
+std::shared_ptr<streamfx::obs::gs::gpu_timers> streamfx::obs::gs::gpu_timers::get()
+{
+	return gpu_timers_instance;
+}
@@ -19,6 +19,9 @@
 
 #pragma once
 #include "common.hpp"
+#include <array>
+#include <atomic>
+#include <map>
 #include <vector>
 #include "plugin.hpp"
 
@@ -37,7 +40,6 @@ namespace streamfx::obs::gs {
 		}
 	};
 
-#ifdef ENABLE_PROFILING
 	static constexpr float_t debug_color_white[4]           = {1.f, 1.f, 1.f, 1.f};
 	static constexpr float_t debug_color_gray[4]            = {.5f, .5f, .5f, 1.f};
 	static constexpr float_t debug_color_black[4]           = {0.f, 0.f, 0.f, 1.f};
@@ -63,28 +65,111 @@ namespace streamfx::obs::gs {
 	static const float_t* debug_color_allocate     = debug_color_red;
 	static const float_t* debug_color_render       = debug_color_teal;
 
+	/** Measures the GPU time of debug_marker scopes with timestamp queries.
+	 *
+	 * Queries are resolved a few frames after they were issued, so reading them never waits on the GPU. Results are
+	 * tracked by named profilers, one for each filter and call site: "GPU Blur" for the marker of the filter itself,
+	 * and "GPU Blur / Render" for the markers inside of it. Must only be used inside the graphics context.
+	 */
+	class gpu_timers {
+		// Frames to wait before a query is read back.
+		static constexpr std::size_t latency = 3;
+
+		struct query {
+			std::shared_ptr<streamfx::util::profiler> profiler;
+			gs_timer_t*                               timer;
+		};
+
+		struct frame {
+			gs_timer_range_t*  range = nullptr;
+			std::vector<query> queries;
+		};
+
+		typedef std::pair<const char*, const char*> scope_t; // Format of the filter, and of the marker.
+
+		std::array<frame, latency + 1>                               _frames;
+		std::size_t                                                  _frame;
+		bool                                                         _open;
+		std::vector<gs_timer_t*>                                     _free;
+		std::vector<const char*>                                     _filters;
+		std::map<scope_t, std::shared_ptr<streamfx::util::profiler>> _profilers;
+		std::atomic<uint64_t>                                        _dropped;
+
+		static void on_frame(void* ptr, uint32_t cx, uint32_t cy) noexcept;
+
+		void resolve(frame& frame);
+
+		public:
+		gpu_timers();
+		~gpu_timers();
+
+		/** Start timing a scope, returns nullptr if it can't be timed.
+		 *
+		 * Markers in the source color with a formatted name start the scope of a filter, every other marker belongs to
+		 * the filter it is nested in. Only the format is used for the profiler name, so that source names can't create
+		 * an endless number of profilers.
+		 *
+		 * @param color  Color of the debug marker.
+		 * @param format Static format string of the debug marker.
+		 */
+		gs_timer_t* begin(const float_t color[4], const char* format);
+
+		/** Stop timing a scope started with begin().
+		 */
+		void end(gs_timer_t* timer);
+
+		/** Number of samples that were thrown away, as the GPU did not have them ready in time.
+		 */
+		uint64_t dropped();
+
+		public /* Singleton */:
+		static void                                           initialize();
+		static void                                           finalize();
+		static std::shared_ptr<streamfx::obs::gs::gpu_timers> get();
+	};
+
+	/** Annotates and times the graphics commands issued during its lifetime, if profiling is enabled.
+	 */
 	class debug_marker {
-		std::string _name;
+		std::string                 _name;
+		bool                        _active;
+		std::shared_ptr<gpu_timers> _timers;
+		gs_timer_t*                 _timer;
 
 		public:
 		inline debug_marker(const float_t color[4], const char* format, ...)
+			: _active(streamfx::util::profiler::is_enabled()), _timers(), _timer(nullptr)
 		{
-			std::size_t       size;
+			if (!_active)
+				return;
+
 			std::vector<char> buffer(64);
 
 			va_list vargs;
+			va_list vargs_retry;
 			va_start(vargs, format);
-			size = static_cast<size_t>(vsnprintf(buffer.data(), buffer.size(), format, vargs));
+			va_copy(vargs_retry, vargs);
+			int size = vsnprintf(buffer.data(), buffer.size(), format, vargs);
+			if ((size > 0) && (static_cast<std::size_t>(size) >= buffer.size())) {
+				buffer.resize(static_cast<std::size_t>(size) + 1);
+				vsnprintf(buffer.data(), buffer.size(), format, vargs_retry);
+			}
+			va_end(vargs_retry);
 			va_end(vargs);
 
-			_name = std::string(buffer.data(), buffer.data() + size);
+			_name = std::string(buffer.data(), buffer.data() + std::max(size, 0));
 			gs_debug_marker_begin(color, _name.c_str());
+			if (_timers = gpu_timers::get(); _timers) {
+				_timer = _timers->begin(color, format);
+			}
 		}
 
 		inline ~debug_marker()
 		{
-			gs_debug_marker_end();
+			if (_timer)
+				_timers->end(_timer);
+			if (_active)
+				gs_debug_marker_end();
 		}
 	};
-#endif
 } // namespace streamfx::obs::gs
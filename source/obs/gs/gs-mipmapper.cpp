@@ -133,10 +133,8 @@ void streamfx::obs::gs::mipmapper::rebuild(std::shared_ptr<streamfx::obs::gs::te
 			size_t   max_mip_level = 1;
 
 			{
-#ifdef ENABLE_PROFILING
 				auto cctr = streamfx::obs::gs::debug_marker(streamfx::obs::gs::debug_color_azure_radiance,
 															"Mip Level %" PRId64 "", 0);
-#endif
 
 #ifdef _WIN32
 				if (gs_get_device_type() == GS_DEVICE_DIRECT3D_11) {
@@ -161,10 +159,8 @@ void streamfx::obs::gs::mipmapper::rebuild(std::shared_ptr<streamfx::obs::gs::te
 
 			// Render each mip map level.
 			for (size_t mip = 1; mip < max_mip_level; mip++) {
-#ifdef ENABLE_PROFILING
 				auto cctr = streamfx::obs::gs::debug_marker(streamfx::obs::gs::debug_color_azure_radiance,
 															"Mip Level %" PRIuMAX, mip);
-#endif
 
 				uint32_t cwidth  = std::max<uint32_t>(width >> mip, 1);
 				uint32_t cheight = std::max<uint32_t>(height >> mip, 1);
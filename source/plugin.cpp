@@ -18,9 +18,15 @@
 */
 
 #include "plugin.hpp"
+#include <charconv>
+#include <chrono>
 #include <fstream>
 #include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "configuration.hpp"
+#include "obs/gs/gs-helper.hpp"
 #include "obs/gs/gs-vertexbuffer.hpp"
 #include "obs/obs-source-tracker.hpp"
 
@@ -89,15 +95,121 @@
 static std::shared_ptr<streamfx::util::threadpool>       _threadpool;
 static std::shared_ptr<streamfx::obs::gs::vertex_buffer> _gs_fstri_vb;
 
+#define ST_CFG_THREADPOOL_WORKERS "threadpool.workers"
+#define ST_CFG_THREADPOOL_AFFINITY "threadpool.affinity"
+#define ST_CFG_THREADPOOL_BACKGROUND_WORKERS "threadpool.background_workers"
+#define ST_CFG_THREADPOOL_BACKGROUND_AFFINITY "threadpool.background_affinity"
+#define ST_CFG_THREADPOOL_BACKGROUND_IDLE "threadpool.background_idle"
+#define ST_CFG_PROFILING "profiling.enabled"
+
+// Highest number of cores accepted for thread pool affinity, if the number of cores is unknown.
+#define ST_CPU_LIMIT 1024
+
+// Parse a single core number, which must be all there is in the text apart from surrounding spaces.
+static bool parse_cpu(std::string_view text, std::size_t& cpu)
+{
+	while (!text.empty() && (text.front() == ' ')) {
+		text.remove_prefix(1);
+	}
+	while (!text.empty() && (text.back() == ' ')) {
+		text.remove_suffix(1);
+	}
+
+	auto result = std::from_chars(text.data(), text.data() + text.size(), cpu);
+	return (result.ec == std::errc()) && (result.ptr == text.data() + text.size());
+}
+
+// Parse a list of cores in the form "0-3,6,8-9".
+static std::vector<std::size_t> parse_cpu_list(std::string_view text)
+{
+	// Cores that don't exist can't be used, and an upper limit keeps a typo from producing billions of entries.
+	std::size_t cores = std::thread::hardware_concurrency();
+	if (cores == 0) {
+		cores = ST_CPU_LIMIT;
+	}
+
+	std::vector<std::size_t> cpus;
+	while (!text.empty()) {
+		std::string_view entry = text.substr(0, text.find(','));
+		text.remove_prefix(std::min(entry.size() + 1, text.size()));
+
+		std::size_t first = 0;
+		std::size_t last  = 0;
+		if (auto dash = entry.find('-'); dash != std::string_view::npos) {
+			if (!parse_cpu(entry.substr(0, dash), first) || !parse_cpu(entry.substr(dash + 1), last)) {
+				first = cores; // Reported as invalid below.
+			}
+		} else if (!parse_cpu(entry, first)) {
+			if (entry.find_first_not_of(' ') == std::string_view::npos) {
+				continue; // Empty entries are harmless.
+			}
+			first = cores;
+		} else {
+			last = first;
+		}
+
+		if ((first >= cores) || (last >= cores) || (last < first)) {
+			DLOG_WARNING("Ignoring invalid core '%.*s' in thread pool affinity, cores range from 0 to %zu.",
+						 static_cast<int>(entry.size()), entry.data(), cores - 1);
+			continue;
+		}
+
+		for (std::size_t cpu = first; cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+static streamfx::util::threadpool_settings threadpool_settings()
+{
+	streamfx::util::threadpool_settings settings;
+	if (auto config = streamfx::configuration::instance(); config) {
+		auto dataptr = config->get();
+
+		if (obs_data_has_user_value(dataptr.get(), ST_CFG_THREADPOOL_WORKERS))
+			settings.workers = static_cast<std::size_t>(
+				std::max<long long>(obs_data_get_int(dataptr.get(), ST_CFG_THREADPOOL_WORKERS), 0));
+		if (obs_data_has_user_value(dataptr.get(), ST_CFG_THREADPOOL_AFFINITY))
+			settings.affinity = parse_cpu_list(obs_data_get_string(dataptr.get(), ST_CFG_THREADPOOL_AFFINITY));
+		if (obs_data_has_user_value(dataptr.get(), ST_CFG_THREADPOOL_BACKGROUND_WORKERS))
+			settings.background_workers = static_cast<std::size_t>(
+				std::max<long long>(obs_data_get_int(dataptr.get(), ST_CFG_THREADPOOL_BACKGROUND_WORKERS), 0));
+		if (obs_data_has_user_value(dataptr.get(), ST_CFG_THREADPOOL_BACKGROUND_AFFINITY))
+			settings.background_affinity =
+				parse_cpu_list(obs_data_get_string(dataptr.get(), ST_CFG_THREADPOOL_BACKGROUND_AFFINITY));
+		if (obs_data_has_user_value(dataptr.get(), ST_CFG_THREADPOOL_BACKGROUND_IDLE))
+			settings.background_idle = obs_data_get_bool(dataptr.get(), ST_CFG_THREADPOOL_BACKGROUND_IDLE);
+	}
+	return settings;
+}
+
+// Run a single step of loading, and remember how long it took.
+static void startup_step(std::vector<std::pair<const char*, std::chrono::nanoseconds>>& steps, const char* name,
+						 void (*step)())
+{
+	auto start = std::chrono::steady_clock::now();
+	step();
+	steps.emplace_back(name, std::chrono::steady_clock::now() - start);
+}
+
 MODULE_EXPORT bool obs_module_load(void)
 try {
 	DLOG_INFO("Loading Version %s", STREAMFX_VERSION_STRING);
 
+	auto                                                          start = std::chrono::steady_clock::now();
+	std::vector<std::pair<const char*, std::chrono::nanoseconds>> steps;
+
 	// Initialize global configuration.
 	streamfx::configuration::initialize();
 
+	// Enable profiling if it was left enabled.
+	if (auto config = streamfx::configuration::instance(); config) {
+		streamfx::util::profiler::set_enabled(obs_data_get_bool(config->get().get(), ST_CFG_PROFILING));
+	}
+
 	// Initialize global Thread Pool.
-	_threadpool = std::make_shared<streamfx::util::threadpool>();
+	_threadpool = std::make_shared<streamfx::util::threadpool>(threadpool_settings());
 
 	// Initialize Source Tracker
 	streamfx::obs::source_tracker::initialize();
@@ -131,67 +243,69 @@ try {
 			vec4_set(vtx.uv[0], 0, 2, 0, 0);
 		}
 		_gs_fstri_vb->update();
+
+		streamfx::obs::gs::gpu_timers::initialize();
 	}
 
 	// Encoders
 	{
 #ifdef ENABLE_ENCODER_AOM_AV1
-		streamfx::encoder::aom::av1::aom_av1_factory::initialize();
+		startup_step(steps, "encoder::aom::av1", streamfx::encoder::aom::av1::aom_av1_factory::initialize);
 #endif
 #ifdef ENABLE_ENCODER_FFMPEG
-		using namespace streamfx::encoder::ffmpeg;
-		ffmpeg_manager::initialize();
+		startup_step(steps, "encoder::ffmpeg", streamfx::encoder::ffmpeg::ffmpeg_manager::initialize);
 #endif
 	}
 
 	// Filters
 	{
 #ifdef ENABLE_FILTER_BLUR
-		streamfx::filter::blur::blur_factory::initialize();
+		startup_step(steps, "filter::blur", streamfx::filter::blur::blur_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_COLOR_GRADE
-		streamfx::filter::color_grade::color_grade_factory::initialize();
+		startup_step(steps, "filter::color_grade", streamfx::filter::color_grade::color_grade_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_DENOISING
-		streamfx::filter::denoising::denoising_factory::initialize();
+		startup_step(steps, "filter::denoising", streamfx::filter::denoising::denoising_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_DISPLACEMENT
-		streamfx::filter::displacement::displacement_factory::initialize();
+		startup_step(steps, "filter::displacement", streamfx::filter::displacement::displacement_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_DYNAMIC_MASK
-		streamfx::filter::dynamic_mask::dynamic_mask_factory::initialize();
+		startup_step(steps, "filter::dynamic_mask", streamfx::filter::dynamic_mask::dynamic_mask_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_NVIDIA_FACE_TRACKING
-		streamfx::filter::nvidia::face_tracking_factory::initialize();
+		startup_step(steps, "filter::nvidia::face_tracking",
+					 streamfx::filter::nvidia::face_tracking_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_SDF_EFFECTS
-		streamfx::filter::sdf_effects::sdf_effects_factory::initialize();
+		startup_step(steps, "filter::sdf_effects", streamfx::filter::sdf_effects::sdf_effects_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_SHADER
-		streamfx::filter::shader::shader_factory::initialize();
+		startup_step(steps, "filter::shader", streamfx::filter::shader::shader_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_TRANSFORM
-		streamfx::filter::transform::transform_factory::initialize();
+		startup_step(steps, "filter::transform", streamfx::filter::transform::transform_factory::initialize);
 #endif
 #ifdef ENABLE_FILTER_UPSCALING
-		streamfx::filter::upscaling::upscaling_factory::initialize();
+		startup_step(steps, "filter::upscaling", streamfx::filter::upscaling::upscaling_factory::initialize);
 #endif
 	}
 
 	// Sources
 	{
 #ifdef ENABLE_SOURCE_MIRROR
-		streamfx::source::mirror::mirror_factory::initialize();
+		startup_step(steps, "source::mirror", streamfx::source::mirror::mirror_factory::initialize);
 #endif
 #ifdef ENABLE_SOURCE_SHADER
-		streamfx::source::shader::shader_factory::initialize();
+		startup_step(steps, "source::shader", streamfx::source::shader::shader_factory::initialize);
 #endif
 	}
 
 	// Transitions
 	{
 #ifdef ENABLE_TRANSITION_SHADER
-		streamfx::transition::shader::shader_factory::initialize();
+		startup_step(steps, "transition::shader", streamfx::transition::shader::shader_factory::initialize);
 #endif
 	}
 
@@ -200,7 +314,12 @@ try {
 	streamfx::ui::handler::initialize();
 #endif
 
-	DLOG_INFO("Loaded Version %s", STREAMFX_VERSION_STRING);
+	// Log how long loading took, and which of the features were responsible for it.
+	DLOG_INFO("Loaded Version %s in %.3f ms", STREAMFX_VERSION_STRING,
+			  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	for (auto& step : steps) {
+		DLOG_INFO("  %-32s %8.3f ms", step.first, std::chrono::duration<double, std::milli>(step.second).count());
+	}
 	return true;
 } catch (std::exception const& ex) {
 	DLOG_ERROR("Unexpected exception in function '%s': %s", __FUNCTION_NAME__, ex.what());
@@ -282,6 +401,7 @@ try {
 
 	// GS Stuff
 	{
+		streamfx::obs::gs::gpu_timers::finalize();
 		_gs_fstri_vb.reset();
 	}
 
@@ -294,6 +414,14 @@ try {
 	//#endif
 
 	// Finalize Thread Pool
+	{
+		std::string report = _threadpool->statistics_report();
+		DLOG_INFO("Thread Pool statistics:");
+		for (std::size_t pos = 0, end = report.find('\n'); end != std::string::npos;
+			 pos = end + 1, end = report.find('\n', pos)) {
+			DLOG_INFO("%s", report.substr(pos, end - pos).c_str());
+		}
+	}
 	_threadpool.reset();
 
 	// Finalize Configuration
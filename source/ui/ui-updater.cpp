@@ -130,8 +130,9 @@ void streamfx::ui::updater_dialog::on_cancel()
 }
 
 streamfx::ui::updater::updater(QMenu* menu)
-	: _updater(), _dialog(nullptr), _gdpr(nullptr), _cfu(nullptr), _cfu_auto(nullptr), _channel(nullptr),
-	  _channel_menu(nullptr), _channel_stable(nullptr), _channel_preview(nullptr), _channel_group(nullptr)
+	: _updater(), _updater_automation_changed(), _updater_channel_changed(), _updater_refreshed(), _dialog(nullptr),
+	  _gdpr(nullptr), _cfu(nullptr), _cfu_auto(nullptr), _channel(nullptr), _channel_menu(nullptr),
+	  _channel_stable(nullptr), _channel_preview(nullptr), _channel_group(nullptr)
 {
 	// Create dialog.
 	_dialog = new updater_dialog();
@@ -180,11 +181,11 @@ streamfx::ui::updater::updater(QMenu* menu)
 
 	{ // Retrieve the updater object and listen to it.
 		_updater = streamfx::updater::instance();
-		_updater->events.automation_changed.add(std::bind(&streamfx::ui::updater::on_updater_automation_changed, this,
-														  std::placeholders::_1, std::placeholders::_2));
-		_updater->events.channel_changed.add(std::bind(&streamfx::ui::updater::on_updater_channel_changed, this,
-													   std::placeholders::_1, std::placeholders::_2));
-		_updater->events.refreshed.add(
+		_updater_automation_changed = _updater->events.automation_changed.add(std::bind(
+			&streamfx::ui::updater::on_updater_automation_changed, this, std::placeholders::_1, std::placeholders::_2));
+		_updater_channel_changed = _updater->events.channel_changed.add(std::bind(
+			&streamfx::ui::updater::on_updater_channel_changed, this, std::placeholders::_1, std::placeholders::_2));
+		_updater_refreshed = _updater->events.refreshed.add(
 			std::bind(&streamfx::ui::updater::on_updater_refreshed, this, std::placeholders::_1));
 
 		// Sync with updater information.
@@ -193,7 +194,13 @@ streamfx::ui::updater::updater(QMenu* menu)
 	}
 }
 
-streamfx::ui::updater::~updater() {}
+streamfx::ui::updater::~updater()
+{
+	// Stop listening to the updater, which may outlive us.
+	_updater->events.automation_changed.remove(_updater_automation_changed);
+	_updater->events.channel_changed.remove(_updater_channel_changed);
+	_updater->events.refreshed.remove(_updater_refreshed);
+}
 
 void streamfx::ui::updater::on_updater_automation_changed(streamfx::updater&, bool value)
 {
@@ -67,6 +67,9 @@ namespace streamfx::ui {
 
 		private:
 		std::shared_ptr<streamfx::updater> _updater;
+		uint64_t                           _updater_automation_changed;
+		uint64_t                           _updater_channel_changed;
+		uint64_t                           _updater_refreshed;
 
 		updater_dialog* _dialog;
 
@@ -22,6 +22,7 @@
 #include "strings.hpp"
 #include <string_view>
 #include "configuration.hpp"
+#include "obs/gs/gs-helper.hpp"
 #include "obs/obs-tools.hpp"
 #include "plugin.hpp"
 
@@ -36,9 +37,15 @@ constexpr std::string_view _i18n_menu_website      = "UI.Menu.Website";
 constexpr std::string_view _i18n_menu_discord      = "UI.Menu.Discord";
 constexpr std::string_view _i18n_menu_github       = "UI.Menu.Github";
 constexpr std::string_view _i18n_menu_about        = "UI.Menu.About";
+constexpr std::string_view _i18n_menu_trace        = "UI.Menu.CaptureTrace";
+constexpr std::string_view _i18n_menu_profiling    = "UI.Menu.Profiling";
 
 // Configuration
 constexpr std::string_view _cfg_have_shown_about = "UI.HaveShownAboutStreamFX";
+constexpr std::string_view _cfg_profiling        = "profiling.enabled";
+
+// Length of traces captured through the menu.
+constexpr std::chrono::seconds _trace_duration = std::chrono::seconds(10);
 
 // URLs
 constexpr std::string_view _url_report_issue = "https://github.com/Xaymar/obs-StreamFX/issues/new?template=issue.md";
@@ -78,6 +85,8 @@ streamfx::ui::handler::handler()
 
 	  _link_website(), _link_discord(), _link_github(),
 
+	  _profiling(), _capture_trace(),
+
 	  _about_action(), _about_dialog(),
 
 	  _translator()
@@ -158,6 +167,18 @@ void streamfx::ui::handler::on_obs_loaded()
 
 		_menu->addSeparator();
 
+		// Profiling
+		_profiling = _menu->addAction(QString::fromUtf8(D_TRANSLATE(_i18n_menu_profiling.data())));
+		_profiling->setMenuRole(QAction::NoRole);
+		_profiling->setCheckable(true);
+		_profiling->setChecked(streamfx::util::profiler::is_enabled());
+		connect(_profiling, &QAction::triggered, this, &streamfx::ui::handler::on_action_profiling);
+
+		// Capture a Trace
+		_capture_trace = _menu->addAction(QString::fromUtf8(D_TRANSLATE(_i18n_menu_trace.data())));
+		_capture_trace->setMenuRole(QAction::NoRole);
+		connect(_capture_trace, &QAction::triggered, this, &streamfx::ui::handler::on_action_capture_trace);
+
 		// About
 		_about_action = _menu->addAction(QString::fromUtf8(D_TRANSLATE(_i18n_menu_about.data())));
 		_about_action->setMenuRole(QAction::NoRole);
@@ -228,6 +249,43 @@ void streamfx::ui::handler::on_action_github(bool)
 	QDesktopServices::openUrl(QUrl(QString::fromUtf8(_url_github.data())));
 }
 
+void streamfx::ui::handler::on_action_profiling(bool checked)
+{
+	streamfx::util::profiler::set_enabled(checked);
+
+	auto config = streamfx::configuration::instance();
+	auto data   = config->get();
+	obs_data_set_bool(data.get(), _cfg_profiling.data(), checked);
+}
+
+void streamfx::ui::handler::on_action_capture_trace(bool)
+{
+	if (streamfx::util::profiler::is_tracing()) {
+		return;
+	}
+
+	streamfx::util::profiler::start_trace();
+	streamfx::threadpool()->schedule_at(
+		[](streamfx::util::threadpool_data_t) {
+			streamfx::util::profiler::stop_trace();
+			streamfx::util::profiler::log_registry();
+			if (auto timers = streamfx::obs::gs::gpu_timers::get(); timers) {
+				DLOG_INFO("GPU timings dropped %" PRIu64 " samples that were not ready in time.", timers->dropped());
+			}
+
+			try {
+				auto now = std::chrono::duration_cast<std::chrono::seconds>(
+					std::chrono::system_clock::now().time_since_epoch());
+				streamfx::util::profiler::export_trace(
+					streamfx::config_file_path("trace-" + std::to_string(now.count()) + ".json"));
+			} catch (const std::exception& ex) {
+				DLOG_ERROR("Failed to export trace: %s", ex.what());
+			}
+		},
+		nullptr, std::chrono::steady_clock::now() + _trace_duration, streamfx::util::threadpool_priority::BACKGROUND,
+		"Trace Export");
+}
+
 void streamfx::ui::handler::on_action_about(bool checked)
 {
 	_about_dialog->show();
@@ -42,6 +42,10 @@ namespace streamfx::ui {
 		QAction* _link_discord;
 		QAction* _link_github;
 
+		// Profiling, Performance Trace
+		QAction* _profiling;
+		QAction* _capture_trace;
+
 		// About Dialog
 		QAction*   _about_action;
 		ui::about* _about_dialog;
@@ -76,6 +80,10 @@ namespace streamfx::ui {
 		void on_action_discord(bool);
 		void on_action_github(bool);
 
+		// Profiling, Performance Trace
+		void on_action_profiling(bool);
+		void on_action_capture_trace(bool);
+
 		// About
 		void on_action_about(bool);
 
@@ -50,6 +50,10 @@
 #define ST_CFG_CHANNEL "updater.channel"
 #define ST_CFG_LASTCHECKEDAT "updater.lastcheckedat"
 
+// Failed checks are retried with an exponentially growing delay, starting at this delay.
+#define ST_RETRY_DELAY std::chrono::seconds(30)
+#define ST_RETRY_LIMIT 3
+
 void streamfx::to_json(nlohmann::json& json, const update_info& info)
 {
 	auto version     = nlohmann::json::object();
@@ -221,9 +225,25 @@ try {
 	}
 
 	// Notify listeners of the update.
+	_task_retries = 0;
 	events.refreshed.call(*this);
 } catch (const std::exception& ex) {
+	// Most failures are temporary network issues, so try again a little later.
+	if (_task_retries < ST_RETRY_LIMIT) {
+		auto delay = ST_RETRY_DELAY * (1 << _task_retries);
+		_task_retries++;
+		D_LOG_WARNING("Checking for updates failed with error '%s', trying again in %lld seconds.", ex.what(),
+					  static_cast<long long>(delay.count()));
+
+		std::lock_guard<std::mutex> lock(_lock);
+		_task = streamfx::threadpool()->schedule_at(std::bind(&streamfx::updater::task, this, std::placeholders::_1),
+													nullptr, std::chrono::steady_clock::now() + delay,
+													streamfx::util::threadpool_priority::BACKGROUND, "Updater");
+		return;
+	}
+
 	// Notify about the error.
+	_task_retries       = 0;
 	std::string message = ex.what();
 	events.error.call(*this, message);
 }
@@ -354,7 +374,7 @@ void streamfx::updater::save()
 }
 
 streamfx::updater::updater()
-	: _lock(), _task(),
+	: _lock(), _task(), _task_retries(0),
 
 	  _gdpr(false), _automation(true), _channel(update_channel::RELEASE), _lastcheckedat(),
 
@@ -381,6 +401,11 @@ streamfx::updater::updater()
 
 streamfx::updater::~updater()
 {
+	// Don't let a pending retry run after we are gone.
+	if (auto pool = streamfx::threadpool(); pool) {
+		pool->pop(_task.lock());
+	}
+
 	save();
 }
 
@@ -454,7 +479,9 @@ void streamfx::updater::refresh()
 		save();
 
 		// Spawn a new task.
-		_task = streamfx::threadpool()->push(std::bind(&streamfx::updater::task, this, std::placeholders::_1), nullptr);
+		_task = streamfx::threadpool()->push(std::bind(&streamfx::updater::task, this, std::placeholders::_1), nullptr,
+											 streamfx::util::threadpool_priority::BACKGROUND,
+											 streamfx::util::threadpool_deadline_t::max(), "Updater");
 	} else {
 		events.refreshed(*this);
 	}
@@ -52,6 +52,7 @@ namespace streamfx {
 		// Internal
 		std::mutex                                        _lock;
 		std::weak_ptr<::streamfx::util::threadpool::task> _task;
+		uint32_t                                          _task_retries;
 
 		// Options
 		std::atomic_bool     _gdpr;
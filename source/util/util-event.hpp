@@ -19,25 +19,69 @@
 
 #pragma once
 #include "common.hpp"
+#include <atomic>
 #include <functional>
-#include <list>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace streamfx::util {
+	/** A list of listeners that are called whenever the event is called.
+	 *
+	 * Calling the event is lock-free and does not allocate. It walks an immutable snapshot of listener slots, which is
+	 * only replaced when a listener is added or enough listeners have been removed. Removing a listener marks its slot
+	 * as dead in O(1), and waits for calls that are still running it on other threads. Snapshots that calls may still
+	 * be walking are released by the first change that finds no call in flight.
+	 *
+	 * Listeners may add or remove listeners, including themselves, while being called.
+	 */
 	template<typename... _args>
 	class event {
-		std::list<std::function<void(_args...)>> _listeners;
-		std::recursive_mutex                     _lock;
+		public:
+		typedef std::function<void(_args...)> listener_t;
+		typedef uint64_t                      handle_t;
+
+		private:
+		struct slot {
+			listener_t            listener;
+			std::atomic<bool>     alive;
+			std::atomic<uint32_t> running;
+
+			slot(listener_t&& fn) : listener(std::move(fn)), alive(true), running(0) {}
+		};
+		typedef std::vector<std::shared_ptr<slot>> snapshot_t;
+
+		// Slots that the current thread is calling right now, linked through the stack frames of call().
+		struct frame {
+			const slot*  current;
+			const frame* previous;
+		};
+
+		std::atomic<const snapshot_t*>                      _snapshot;
+		std::atomic<size_t>                                 _callers;
+		std::atomic<size_t>                                 _live;
+		size_t                                              _dead;
+		std::vector<std::unique_ptr<const snapshot_t>>      _retired;
+		std::unordered_map<handle_t, std::shared_ptr<slot>> _handles;
+		std::recursive_mutex                                _lock;
+		handle_t                                            _next_handle;
 
 		std::function<void()> _cb_fill;
 		std::function<void()> _cb_clear;
 
 		public /* constructor */:
-		event() : _listeners(), _lock(), _cb_fill(), _cb_clear() {}
+		event()
+			: _snapshot(nullptr), _callers(0), _live(0), _dead(0), _retired(), _handles(), _lock(), _next_handle(0),
+			  _cb_fill(), _cb_clear()
+		{}
 		virtual ~event()
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
 			this->clear();
+
+			// Destroying an event that is still being called is not supported, so nothing can be walking these.
+			_retired.clear();
 		}
 
 		/* Copy Constructor */
@@ -46,12 +90,7 @@ namespace streamfx::util {
 		/* Move Constructor */
 		event(event<_args...>&& other) : event()
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			std::lock_guard<std::recursive_mutex> lgo(other._lock);
-
-			_listeners.swap(other._listeners);
-			_cb_fill.swap(other._cb_fill);
-			_cb_clear.swap(other._cb_clear);
+			*this = std::move(other);
 		}
 
 		public /* operators */:
@@ -65,7 +104,12 @@ namespace streamfx::util {
 			std::lock_guard<std::recursive_mutex> lg(_lock);
 			std::lock_guard<std::recursive_mutex> lgo(other._lock);
 
-			_listeners.swap(other._listeners);
+			_snapshot.store(other._snapshot.exchange(_snapshot.load()));
+			_live.store(other._live.exchange(_live.load()));
+			std::swap(_dead, other._dead);
+			_retired.swap(other._retired);
+			_handles.swap(other._handles);
+			std::swap(_next_handle, other._next_handle);
 			_cb_fill.swap(other._cb_fill);
 			_cb_clear.swap(other._cb_clear);
 
@@ -82,9 +126,25 @@ namespace streamfx::util {
 		template<typename... _largs>
 		inline void call(_args... args)
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			for (auto& l : _listeners) {
-				l(args...);
+			// Announce the call before loading the snapshot, so that writers know it may still be in use.
+			call_scope cs(_callers);
+
+			const snapshot_t* snapshot = _snapshot.load();
+			if (!snapshot) {
+				return;
+			}
+
+			for (auto& entry : *snapshot) {
+				slot& s = *entry;
+				if (!s.alive.load()) {
+					continue;
+				}
+
+				// Mark the slot as running before checking it again, so that remove() either sees us or we see it.
+				slot_scope ss(s);
+				if (s.alive.load()) {
+					s.listener(args...);
+				}
 			}
 		}
 
@@ -92,39 +152,67 @@ namespace streamfx::util {
 
 		/** Add a new listener to the event.
 		 * @param listener A listener bound with std::bind or a std::function.
+		 * @return A handle that can be used to remove the listener again.
 		 */
-		inline void add(std::function<void(_args...)> listener)
+		inline handle_t add(listener_t listener)
 		{
 			std::lock_guard<std::recursive_mutex> lg(_lock);
-			if (_listeners.size() == 0) {
-				if (_cb_fill) {
-					_cb_fill();
-				}
+			if ((_live.load() == 0) && _cb_fill) {
+				_cb_fill();
 			}
-			_listeners.push_back(listener);
+
+			auto entry   = std::make_shared<slot>(std::move(listener));
+			auto handle  = ++_next_handle;
+			auto updated = compact(1);
+			updated->push_back(entry);
+			_handles.emplace(handle, std::move(entry));
+			_live++;
+			publish(std::move(updated));
+			return handle;
 		}
-		inline event<_args...>& operator+=(std::function<void(_args...)> listener)
+		inline event<_args...>& operator+=(listener_t listener)
 		{
-			this->add(listener);
+			this->add(std::move(listener));
 			return *this;
 		}
 
 		/** Remove an existing listener from the event.
-		 * @param listener A listener bound with std::bind or a std::function.
+		 *
+		 * Once this returns, the listener is no longer running on any other thread.
+		 *
+		 * @param handle The handle returned by add().
 		 */
-		inline void remove(std::function<void(_args...)> listener)
+		inline void remove(handle_t handle)
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			_listeners.remove(listener);
-			if (_listeners.size() == 0) {
-				if (_cb_clear) {
-					_cb_clear();
+			std::shared_ptr<slot> entry;
+			{
+				std::lock_guard<std::recursive_mutex> lg(_lock);
+				auto                                  kv = _handles.find(handle);
+				if (kv == _handles.end()) {
+					return;
+				}
+				entry = std::move(kv->second);
+				_handles.erase(kv);
+				entry->alive.store(false);
+
+				// Dead slots are skipped by calls, and only cleaned up once they outnumber the living ones.
+				_dead++;
+				if (--_live == 0) {
+					publish(nullptr);
+					if (_cb_clear) {
+						_cb_clear();
+					}
+				} else if (_dead > _live.load()) {
+					publish(compact(0));
 				}
 			}
+
+			// Wait outside of the lock, as the listener may be adding or removing listeners itself.
+			wait_for(*entry);
 		}
-		inline event<_args...>& operator-=(std::function<void(_args...)> listener)
+		inline event<_args...>& operator-=(handle_t handle)
 		{
-			this->remove(listener);
+			this->remove(handle);
 			return *this;
 		}
 
@@ -133,8 +221,7 @@ namespace streamfx::util {
 		 */
 		inline bool empty()
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			return _listeners.empty();
+			return _live.load() == 0;
 		}
 		inline operator bool()
 		{
@@ -142,13 +229,29 @@ namespace streamfx::util {
 		}
 
 		/** Clear the list of listeners for the event.
+		 *
+		 * Once this returns, none of the listeners are running on any other thread.
 		 */
 		inline void clear()
 		{
-			std::lock_guard<std::recursive_mutex> lg(_lock);
-			_listeners.clear();
-			if (_cb_clear) {
-				_cb_clear();
+			std::vector<std::shared_ptr<slot>> entries;
+			{
+				std::lock_guard<std::recursive_mutex> lg(_lock);
+				entries.reserve(_handles.size());
+				for (auto& kv : _handles) {
+					kv.second->alive.store(false);
+					entries.push_back(std::move(kv.second));
+				}
+				_handles.clear();
+				_live.store(0);
+				publish(nullptr);
+				if (_cb_clear) {
+					_cb_clear();
+				}
+			}
+
+			for (auto& entry : entries) {
+				wait_for(*entry);
 			}
 		}
 		inline event<_args...>& operator=(std::nullptr_t)
@@ -170,5 +273,86 @@ namespace streamfx::util {
 			std::lock_guard<std::recursive_mutex> lg(_lock);
 			this->_cb_clear = cb;
 		}
+
+		private:
+		struct call_scope {
+			std::atomic<size_t>& callers;
+
+			call_scope(std::atomic<size_t>& value) : callers(value)
+			{
+				callers.fetch_add(1);
+			}
+			~call_scope()
+			{
+				callers.fetch_sub(1, std::memory_order_release);
+			}
+		};
+
+		struct slot_scope {
+			slot& s;
+			frame f;
+
+			slot_scope(slot& value) : s(value), f{&value, running()}
+			{
+				s.running.fetch_add(1);
+				running() = &f;
+			}
+			~slot_scope()
+			{
+				running() = f.previous;
+				s.running.fetch_sub(1, std::memory_order_release);
+			}
+		};
+
+		static const frame*& running()
+		{
+			static thread_local const frame* frames = nullptr;
+			return frames;
+		}
+
+		// Wait until no other thread runs the slot any more. Calls further up on this thread are not waited for, as
+		// they can only finish once we return.
+		static void wait_for(const slot& s)
+		{
+			uint32_t own = 0;
+			for (auto f = running(); f != nullptr; f = f->previous) {
+				if (f->current == &s) {
+					own++;
+				}
+			}
+			while (s.running.load(std::memory_order_acquire) > own) {
+				std::this_thread::yield();
+			}
+		}
+
+		// Build a new snapshot of all living slots. Requires _lock.
+		std::unique_ptr<snapshot_t> compact(size_t reserve)
+		{
+			auto updated = std::make_unique<snapshot_t>();
+			updated->reserve(_live.load() + reserve);
+			if (auto current = _snapshot.load(); current) {
+				for (auto& entry : *current) {
+					if (entry->alive.load()) {
+						updated->push_back(entry);
+					}
+				}
+			}
+			_dead = 0;
+			return updated;
+		}
+
+		// Replace the snapshot, and release old ones if no call can be walking them. Requires _lock.
+		void publish(std::unique_ptr<snapshot_t> updated)
+		{
+			if (!updated) {
+				_dead = 0;
+			}
+			if (auto previous = _snapshot.exchange(updated.release()); previous) {
+				_retired.emplace_back(previous);
+			}
+			if (_callers.load() == 0) {
+				_retired.clear();
+			}
+		}
 	};
 } // namespace streamfx::util
@@ -18,142 +18,394 @@
  */
 
 #include "util-profiler.hpp"
-#include <iterator>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "util/util-logging.hpp"
 
-streamfx::util::profiler::profiler() {}
+#ifdef _DEBUG
+#define ST_PREFIX "<%s> "
+#define D_LOG_ERROR(x, ...) P_LOG_ERROR(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_WARNING(x, ...) P_LOG_WARN(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_INFO(x, ...) P_LOG_INFO(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#define D_LOG_DEBUG(x, ...) P_LOG_DEBUG(ST_PREFIX##x, __FUNCTION_SIG__, __VA_ARGS__)
+#else
+#define ST_PREFIX "<util::profiler> "
+#define D_LOG_ERROR(...) P_LOG_ERROR(ST_PREFIX __VA_ARGS__)
+#define D_LOG_WARNING(...) P_LOG_WARN(ST_PREFIX __VA_ARGS__)
+#define D_LOG_INFO(...) P_LOG_INFO(ST_PREFIX __VA_ARGS__)
+#define D_LOG_DEBUG(...) P_LOG_DEBUG(ST_PREFIX __VA_ARGS__)
+#endif
+
+// Number of events each thread keeps, older events are overwritten by newer ones.
+#define ST_TRACE_RING_SIZE 8192
+
+// Number of threads that exited during a trace whose events are still kept for the export.
+#define ST_TRACE_FINISHED_RINGS 16
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the highest set bit, value must not be zero.
+static inline std::size_t highest_bit(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return static_cast<std::size_t>(index);
+#else
+	return static_cast<std::size_t>(63 - __builtin_clzll(value));
+#endif
+}
+
+struct trace_event {
+	const char* name;
+	int64_t     start;
+	int64_t     duration;
+};
+
+struct trace_ring {
+	std::mutex               lock;
+	std::vector<trace_event> events;
+	std::size_t              next;
+	std::size_t              count;
+	uint32_t                 thread;
+};
+
+static std::mutex                                                                   _registry_lock;
+static std::map<std::string, std::weak_ptr<streamfx::util::profiler>, std::less<>> _registry;
+static std::mutex                                                                   _rings_lock;
+static std::vector<std::shared_ptr<trace_ring>>                                     _rings;
+static std::deque<std::shared_ptr<trace_ring>>                                      _finished_rings;
+static uint32_t                                                                     _rings_next_thread = 0;
+
+// Hands the ring of a thread over to the finished ones when the thread exits, so that threads which come and go with
+// encoders don't each leave a ring behind.
+struct trace_ring_holder {
+	std::shared_ptr<trace_ring> ring;
+
+	~trace_ring_holder()
+	{
+		if (!ring) {
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(_rings_lock);
+		_rings.erase(std::remove(_rings.begin(), _rings.end(), ring), _rings.end());
+		if (ring->count > 0) {
+			_finished_rings.push_back(ring);
+			if (_finished_rings.size() > ST_TRACE_FINISHED_RINGS) {
+				_finished_rings.pop_front();
+			}
+		}
+	}
+};
+static thread_local trace_ring_holder _local_ring;
+
+std::atomic_bool streamfx::util::profiler::_enabled{false};
+std::atomic_bool streamfx::util::profiler::_tracing{false};
+
+streamfx::util::profiler::profiler()
+	: _buckets(), _count(0), _total(0), _minimum(std::numeric_limits<uint64_t>::max()), _maximum(0), _name()
+{
+	for (auto& bucket : _buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
 
 streamfx::util::profiler::~profiler() {}
 
-std::shared_ptr<streamfx::util::profiler::instance> streamfx::util::profiler::track()
+std::size_t streamfx::util::profiler::bucket_index(uint64_t value)
 {
-	return std::make_shared<streamfx::util::profiler::instance>(shared_from_this());
+	// Small values get a bucket each.
+	if (value < sub_bucket_count) {
+		return static_cast<std::size_t>(value);
+	}
+
+	constexpr uint64_t largest = (uint64_t(1) << (max_magnitude + 1)) - 1;
+	value                      = std::min(value, largest);
+
+	// Everything else is grouped by its magnitude, which is then split evenly into sub buckets.
+	std::size_t magnitude = highest_bit(value);
+	std::size_t shift     = magnitude - sub_bucket_bits;
+	return ((magnitude - sub_bucket_bits + 1) * sub_bucket_count)
+		   + static_cast<std::size_t>((value >> shift) - sub_bucket_count);
 }
 
-void streamfx::util::profiler::track(std::chrono::nanoseconds duration)
+uint64_t streamfx::util::profiler::bucket_value(std::size_t index)
 {
-	std::unique_lock<std::mutex> ul(_timings_lock);
-	auto                         itr = _timings.find(duration);
-	if (itr == _timings.end()) {
-		_timings.emplace(duration, 1u);
-	} else {
-		itr->second++;
+	if (index < sub_bucket_count) {
+		return static_cast<uint64_t>(index);
 	}
+
+	std::size_t shift = (index / sub_bucket_count) - 1;
+	return static_cast<uint64_t>(sub_bucket_count + (index % sub_bucket_count)) << shift;
 }
 
-uint64_t streamfx::util::profiler::count()
+std::string_view streamfx::util::profiler::name()
+{
+	return _name;
+}
+
+std::shared_ptr<streamfx::util::profiler> streamfx::util::profiler::create(std::string_view name)
 {
-	uint64_t count = 0;
+	std::unique_lock<std::mutex> lock(_registry_lock);
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
-	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), std::inserter(copy_timings, copy_timings.end()));
+	auto itr = _registry.find(name);
+	if (itr == _registry.end()) {
+		itr = _registry.emplace(std::string(name), std::weak_ptr<streamfx::util::profiler>()).first;
+	} else if (auto existing = itr->second.lock(); existing) {
+		return existing;
 	}
 
-	for (auto kv : copy_timings) {
-		count += kv.second;
+	// Registry entries are never removed, so the name remains valid for traces even after the profiler is gone.
+	auto profiler   = create();
+	profiler->_name = itr->first;
+	itr->second     = profiler;
+	return profiler;
+}
+
+void streamfx::util::profiler::log_registry()
+{
+	std::unique_lock<std::mutex> lock(_registry_lock);
+
+	D_LOG_INFO("%-30s: %10s %10s %10s %10s %10s", "Profiler", "Count", "Average", "50.0%ile", "99.0%ile", "99.9%ile");
+	for (auto& kv : _registry) {
+		auto profiler = kv.second.lock();
+		if (!profiler || (profiler->count() == 0)) {
+			continue;
+		}
+
+		D_LOG_INFO("  %-28s: %10" PRIu64 " %8" PRId64 "µs %8" PRId64 "µs %8" PRId64 "µs %8" PRId64 "µs",
+				   kv.first.c_str(), profiler->count(), static_cast<int64_t>(profiler->average_duration() / 1000.0),
+				   static_cast<int64_t>(
+					   std::chrono::duration_cast<std::chrono::microseconds>(profiler->percentile(0.5)).count()),
+				   static_cast<int64_t>(
+					   std::chrono::duration_cast<std::chrono::microseconds>(profiler->percentile(0.99)).count()),
+				   static_cast<int64_t>(
+					   std::chrono::duration_cast<std::chrono::microseconds>(profiler->percentile(0.999)).count()));
 	}
+}
 
-	return count;
+void streamfx::util::profiler::set_enabled(bool enabled)
+{
+	if (_enabled.exchange(enabled) != enabled) {
+		D_LOG_INFO("Profiling is now %s.", enabled ? "enabled" : "disabled");
+	}
 }
 
-std::chrono::nanoseconds streamfx::util::profiler::total_duration()
+void streamfx::util::profiler::start_trace()
 {
-	std::chrono::nanoseconds duration{0};
+	{ // Throw away the events of the previous trace.
+		std::unique_lock<std::mutex> lock(_rings_lock);
+		_finished_rings.clear();
+		for (auto& ring : _rings) {
+			std::unique_lock<std::mutex> ring_lock(ring->lock);
+			ring->next  = 0;
+			ring->count = 0;
+		}
+	}
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
-	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), std::inserter(copy_timings, copy_timings.end()));
+	_tracing.store(true);
+	D_LOG_INFO("Started trace.", "");
+}
+
+void streamfx::util::profiler::stop_trace()
+{
+	_tracing.store(false);
+	D_LOG_INFO("Stopped trace.", "");
+}
+
+void streamfx::util::profiler::trace(const char* name, std::chrono::steady_clock::time_point start,
+									 std::chrono::steady_clock::time_point end)
+{
+	if (!is_tracing()) {
+		return;
 	}
 
-	for (auto kv : copy_timings) {
-		duration += kv.first * kv.second;
+	auto& ring = _local_ring.ring;
+	if (!ring) {
+		ring         = std::make_shared<trace_ring>();
+		ring->events = std::vector<trace_event>(ST_TRACE_RING_SIZE);
+		ring->next   = 0;
+		ring->count  = 0;
+
+		std::unique_lock<std::mutex> lock(_rings_lock);
+		ring->thread = _rings_next_thread++;
+		_rings.push_back(ring);
 	}
 
-	return duration;
+	// Only ever contended while a trace is being exported.
+	std::unique_lock<std::mutex> lock(ring->lock);
+	auto&                        event = ring->events[ring->next];
+	event.name                         = name;
+	event.start    = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+	event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	ring->next     = (ring->next + 1) % ST_TRACE_RING_SIZE;
+	ring->count    = std::min<std::size_t>(ring->count + 1, ST_TRACE_RING_SIZE);
 }
 
-double_t streamfx::util::profiler::average_duration()
+static void write_json_string(std::ofstream& stream, const char* text)
 {
-	std::chrono::nanoseconds duration{0};
-	uint64_t                 count = 0;
+	stream << '"';
+	for (; *text; text++) {
+		if ((*text == '"') || (*text == '\\')) {
+			stream << '\\' << *text;
+		} else if (static_cast<unsigned char>(*text) >= 0x20) {
+			stream << *text;
+		}
+	}
+	stream << '"';
+}
+
+static void write_json_time(std::ofstream& stream, int64_t nanoseconds)
+{
+	// Chrome Trace Event timestamps are in microseconds, but may have a fractional part.
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%" PRId64 ".%03" PRId64, nanoseconds / 1000, nanoseconds % 1000);
+	stream << buffer;
+}
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
+void streamfx::util::profiler::export_trace(const std::filesystem::path& file)
+{
+	std::vector<std::shared_ptr<trace_ring>> rings;
 	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), std::inserter(copy_timings, copy_timings.end()));
+		std::unique_lock<std::mutex> lock(_rings_lock);
+		rings = _rings;
+		rings.insert(rings.end(), _finished_rings.begin(), _finished_rings.end());
 	}
 
-	for (auto kv : copy_timings) {
-		duration += kv.first * kv.second;
-		count += kv.second;
+	std::ofstream stream(file, std::ios::out | std::ios::trunc);
+	if (!stream.good()) {
+		throw std::runtime_error("Failed to open file for trace export.");
 	}
 
-	return double_t(duration.count()) / double_t(count);
+	std::size_t written = 0;
+	stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	for (auto& ring : rings) {
+		std::vector<trace_event> events;
+		{
+			std::unique_lock<std::mutex> lock(ring->lock);
+			events.reserve(ring->count);
+			for (std::size_t idx = ring->count; idx > 0; idx--) {
+				events.push_back(ring->events[(ring->next + ST_TRACE_RING_SIZE - idx) % ST_TRACE_RING_SIZE]);
+			}
+		}
+
+		for (auto& event : events) {
+			stream << ((written++ > 0) ? ",\n" : "\n") << "{\"name\":";
+			write_json_string(stream, event.name);
+			stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->thread << ",\"ts\":";
+			write_json_time(stream, event.start);
+			stream << ",\"dur\":";
+			write_json_time(stream, event.duration);
+			stream << "}";
+		}
+	}
+	stream << "\n]}\n";
+
+	D_LOG_INFO("Exported %zu events from %zu threads to '%s'.", written, rings.size(), file.u8string().c_str());
 }
 
-template<typename T>
-inline bool is_equal(T a, T b, T c)
+std::shared_ptr<streamfx::util::profiler::instance> streamfx::util::profiler::track()
 {
-	return (a == b) || ((a >= (b - c)) && (a <= (b + c)));
+	if (!is_enabled()) {
+		return nullptr;
+	}
+
+	return std::make_shared<streamfx::util::profiler::instance>(shared_from_this());
 }
 
-std::chrono::nanoseconds streamfx::util::profiler::percentile(double_t percentile, bool by_time)
+void streamfx::util::profiler::track(std::chrono::nanoseconds duration)
 {
-	constexpr double_t edge  = 0.00005;
-	uint64_t           calls = count();
+	uint64_t value = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
 
-	std::map<std::chrono::nanoseconds, size_t> copy_timings;
-	{
-		std::unique_lock<std::mutex> ul(_timings_lock);
-		copy(_timings.begin(), _timings.end(), inserter(copy_timings, copy_timings.end()));
+	_buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_total.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t minimum = _minimum.load(std::memory_order_relaxed);
+	while ((value < minimum) && !_minimum.compare_exchange_weak(minimum, value, std::memory_order_relaxed)) {
+	}
+	uint64_t maximum = _maximum.load(std::memory_order_relaxed);
+	while ((value > maximum) && !_maximum.compare_exchange_weak(maximum, value, std::memory_order_relaxed)) {
+	}
+}
+
+uint64_t streamfx::util::profiler::count()
+{
+	return _count.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds streamfx::util::profiler::total_duration()
+{
+	return std::chrono::nanoseconds(static_cast<int64_t>(_total.load(std::memory_order_relaxed)));
+}
+
+double_t streamfx::util::profiler::average_duration()
+{
+	return double_t(_total.load(std::memory_order_relaxed)) / double_t(_count.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds streamfx::util::profiler::percentile(double_t percentile, bool by_time)
+{
+	uint64_t minimum = _minimum.load(std::memory_order_relaxed);
+	uint64_t maximum = _maximum.load(std::memory_order_relaxed);
+	if (minimum > maximum) { // Nothing was tracked yet.
+		return std::chrono::nanoseconds(-1);
 	}
+
 	if (by_time) { // Return by time percentile.
-		// Find largest and smallest time.
-		std::chrono::nanoseconds smallest = copy_timings.begin()->first;
-		std::chrono::nanoseconds largest  = copy_timings.rbegin()->first;
-		std::chrono::nanoseconds variance = largest - smallest;
-
-		for (auto kv : copy_timings) {
-			double_t kv_pct = double_t((kv.first - smallest).count()) / double_t(variance.count());
-			if (is_equal<double_t>(kv_pct, percentile, edge) || (kv_pct > percentile)) {
-				return std::chrono::nanoseconds(kv.first);
+		// Find the first bucket that could hold the requested point between the smallest and largest time.
+		uint64_t target = minimum + static_cast<uint64_t>(double_t(maximum - minimum) * percentile);
+		for (std::size_t idx = bucket_index(target); idx < bucket_count; idx++) {
+			if (_buckets[idx].load(std::memory_order_relaxed) > 0) {
+				return std::chrono::nanoseconds(
+					static_cast<int64_t>(std::clamp(bucket_value(idx), minimum, maximum)));
 			}
 		}
 	} else { // Return by call percentile.
-		if (percentile == 0.0) {
-			return copy_timings.begin()->first;
+		// Samples may be added while we look, so compare against the sum of what we actually saw.
+		uint64_t calls = 0;
+		for (auto& bucket : _buckets) {
+			calls += bucket.load(std::memory_order_relaxed);
 		}
 
-		uint64_t accu_calls_now = 0;
-		for (auto kv : copy_timings) {
-			uint64_t accu_calls_last = accu_calls_now;
-			accu_calls_now += kv.second;
-
-			double_t percentile_last = double_t(accu_calls_last) / double_t(calls);
-			double_t percentile_now  = double_t(accu_calls_now) / double_t(calls);
+		double_t target = double_t(calls) * percentile;
+		uint64_t accu   = 0;
+		for (std::size_t idx = 0; idx < bucket_count; idx++) {
+			uint64_t bucket = _buckets[idx].load(std::memory_order_relaxed);
+			if (bucket == 0) {
+				continue;
+			}
 
-			if (is_equal<double_t>(percentile, percentile_now, edge)
-				|| ((percentile_last < percentile) && (percentile_now > percentile))) {
-				return std::chrono::nanoseconds(kv.first);
+			accu += bucket;
+			if (double_t(accu) >= target) {
+				return std::chrono::nanoseconds(static_cast<int64_t>(std::clamp(bucket_value(idx), minimum, maximum)));
 			}
 		}
 	}
 
-	return std::chrono::nanoseconds(-1);
+	return std::chrono::nanoseconds(maximum);
 }
 
 streamfx::util::profiler::instance::instance(std::shared_ptr<streamfx::util::profiler> parent)
-	: _parent(parent), _start(std::chrono::high_resolution_clock::now())
+	: _parent(parent), _start(std::chrono::steady_clock::now())
 {}
 
 streamfx::util::profiler::instance::~instance()
 {
-	auto end = std::chrono::high_resolution_clock::now();
+	auto end = std::chrono::steady_clock::now();
 	auto dur = end - _start;
 	if (_parent) {
 		_parent->track(dur);
+		if (is_tracing() && !_parent->_name.empty()) {
+			trace(_parent->_name.data(), _start, end);
+		}
 	}
 }
 
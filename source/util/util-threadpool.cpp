@@ -20,7 +20,18 @@
 #include "util-threadpool.hpp"
 #include "common.hpp"
 #include <cstddef>
+#include <cstdio>
 #include "util/util-logging.hpp"
+#include "util/util-profiler.hpp"
+
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__) // Windows
+#define ST_WINDOWS
+#include <Windows.h>
+#elif defined(__linux__)
+#define ST_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #ifdef _DEBUG
 #define ST_PREFIX "<%s> "
@@ -39,104 +50,795 @@
 // Most Tasks likely wait for IO, so we can use that time for other tasks.
 #define ST_CONCURRENCY_MULTIPLIER 2
 
-streamfx::util::threadpool::threadpool()
-	: _workers(), _worker_stop(false), _worker_idx(0), _tasks(), _tasks_lock(), _tasks_cv()
+// Identifies the pool and queue that the current thread is working for, if any.
+static thread_local streamfx::util::threadpool* local_pool  = nullptr;
+static thread_local std::size_t                 local_index = 0;
+
+// Apply the affinity and scheduling class meant for a worker to the calling thread.
+static void apply_layout(std::size_t index, const std::vector<std::size_t>& cpus, bool idle)
 {
-	std::size_t concurrency = static_cast<size_t>(std::thread::hardware_concurrency() * ST_CONCURRENCY_MULTIPLIER);
+#if defined(ST_WINDOWS)
+	if (!cpus.empty()) {
+		DWORD_PTR mask = 0;
+		for (auto cpu : cpus) {
+			if (cpu < (sizeof(DWORD_PTR) * 8)) {
+				mask |= DWORD_PTR(1) << cpu;
+			}
+		}
+		if ((mask == 0) || (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)) {
+			D_LOG_WARNING("Worker %" PRIx32 " failed to apply affinity.", static_cast<uint32_t>(index));
+		}
+	}
+	if (idle && !SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN)) {
+		D_LOG_WARNING("Worker %" PRIx32 " failed to enter background mode.", static_cast<uint32_t>(index));
+	}
+#elif defined(ST_LINUX)
+	if (!cpus.empty()) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (auto cpu : cpus) {
+			if (cpu < CPU_SETSIZE) {
+				CPU_SET(cpu, &set);
+			}
+		}
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) != 0) {
+			D_LOG_WARNING("Worker %" PRIx32 " failed to apply affinity.", static_cast<uint32_t>(index));
+		}
+	}
+	if (idle) {
+		sched_param param = {};
+		if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+			D_LOG_WARNING("Worker %" PRIx32 " failed to enter SCHED_IDLE.", static_cast<uint32_t>(index));
+		}
+	}
+#else
+	if (!cpus.empty() || idle) {
+		D_LOG_WARNING("Worker %" PRIx32 " can't apply affinity or scheduling class on this platform.",
+					  static_cast<uint32_t>(index));
+	}
+#endif
+}
+
+static std::string format_cpus(const std::vector<std::size_t>& cpus)
+{
+	if (cpus.empty()) {
+		return "any";
+	}
+
+	std::string text;
+	for (auto cpu : cpus) {
+		if (!text.empty()) {
+			text += ",";
+		}
+		text += std::to_string(cpu);
+	}
+	return text;
+}
+
+streamfx::util::threadpool::threadpool(threadpool_settings settings)
+	: _settings(settings), _workers(), _worker_stop(false), _worker_idx(0), _worker_sleeping(0), _tasks_queued(),
+	  _tasks_peak(), _tasks_lock(), _tasks_cv(), _background_sleeping(0), _background_cv(), _background_active(0),
+	  _background_limit(1), _freelist(std::make_shared<task_freelist>()), _allocations(0), _labels_lock(), _labels(),
+	  _timer(), _timer_lock(), _timer_cv(), _timer_tasks()
+{
+	if (_settings.workers == 0) {
+		_settings.workers = static_cast<size_t>(std::thread::hardware_concurrency() * ST_CONCURRENCY_MULTIPLIER);
+		_settings.workers = std::max<std::size_t>(_settings.workers, 1);
+	}
+
+	if (_settings.background_workers > 0) {
+		// Dedicated background workers only ever run background tasks, so each of them may hold a slot.
+		_background_limit = _settings.background_workers;
+	} else {
+		// Background tasks may only ever occupy half of the workers, so that there is always someone left to pick up
+		// realtime and normal tasks.
+		_background_limit = std::max<std::size_t>(_settings.workers / 2, 1);
+	}
+	for (auto& queued : _tasks_queued) {
+		queued.store(0);
+	}
+	for (auto& peak : _tasks_peak) {
+		peak.store(0);
+	}
+
+	D_LOG_INFO("Using %zu workers on cores '%s', and %zu background workers on cores '%s'%s.", _settings.workers,
+			   format_cpus(_settings.affinity).c_str(), _settings.background_workers,
+			   format_cpus(_settings.background_affinity).c_str(),
+			   (_settings.background_idle && (_settings.background_workers > 0)) ? " with idle priority" : "");
+
+	// All queues must exist before the first worker starts, as idle workers look through every queue.
+	std::size_t concurrency = _settings.workers + _settings.background_workers;
+	_workers.reserve(concurrency);
+	for (std::size_t n = 0; n < concurrency; n++) {
+		auto worker             = std::make_unique<streamfx::util::threadpool::worker>();
+		worker->background      = (n >= _settings.workers);
+		worker->stats.wait_time = streamfx::util::profiler::create();
+		worker->stats.run_time  = streamfx::util::profiler::create();
+		_workers.emplace_back(std::move(worker));
+	}
 	for (std::size_t n = 0; n < concurrency; n++) {
-		_workers.emplace_back(std::bind(&streamfx::util::threadpool::work, this));
+		_workers[n]->thread = std::thread(std::bind(&streamfx::util::threadpool::work, this, n));
 	}
+
+	// A single thread takes care of all timed tasks, so that nobody else has to keep track of time.
+	_timer = std::thread(std::bind(&streamfx::util::threadpool::timer, this));
 }
 
 streamfx::util::threadpool::~threadpool()
 {
 	_worker_stop = true;
-	_tasks_cv.notify_all();
-	for (auto& thread : _workers) {
+	{
+		std::unique_lock<std::mutex> lock(_timer_lock);
+		_timer_cv.notify_all();
+	}
+	if (_timer.joinable()) {
+		_timer.join();
+	}
+	_timer_tasks.clear();
+
+	{
+		std::unique_lock<std::mutex> lock(_tasks_lock);
 		_tasks_cv.notify_all();
-		if (thread.joinable()) {
-			thread.join();
+		_background_cv.notify_all();
+	}
+	for (auto& worker : _workers) {
+		if (worker->thread.joinable()) {
+			worker->thread.join();
 		}
 	}
 }
 
-std::shared_ptr<::streamfx::util::threadpool::task> streamfx::util::threadpool::push(threadpool_callback_t fn,
-																					 threadpool_data_t     data)
+void streamfx::util::threadpool::pop(std::shared_ptr<::streamfx::util::threadpool::task> work)
 {
-	auto task = std::make_shared<streamfx::util::threadpool::task>(fn, data);
+	if (work) {
+		work->_is_dead.store(true);
+	}
+}
 
-	std::unique_lock<std::mutex> lock(_tasks_lock);
-	_tasks.emplace_back(task);
-	_tasks_cv.notify_one();
+const streamfx::util::threadpool_settings& streamfx::util::threadpool::layout()
+{
+	return _settings;
+}
 
-	return task;
+uint64_t streamfx::util::threadpool::allocations()
+{
+	return _freelist->allocations() + _allocations.load();
 }
 
-void streamfx::util::threadpool::pop(std::shared_ptr<::streamfx::util::threadpool::task> work)
+streamfx::util::threadpool::statistics* streamfx::util::threadpool::find_statistics(const char* label)
 {
-	if (work) {
-		work->_is_dead.store(true);
+	std::unique_lock<std::mutex> lock(_labels_lock);
+	auto                         itr = _labels.find(label);
+	if (itr != _labels.end()) {
+		return itr->second.get();
 	}
+
+	auto stats       = std::make_unique<streamfx::util::threadpool::statistics>();
+	stats->name      = label;
+	stats->wait_time = streamfx::util::profiler::create();
+	stats->run_time  = streamfx::util::profiler::create();
+	return _labels.emplace(label, std::move(stats)).first->second.get();
 }
 
-void streamfx::util::threadpool::work()
+static void format_statistics(std::string& text, const char* name, uint64_t executed, uint64_t dropped,
+							  uint64_t killed, std::shared_ptr<streamfx::util::profiler> wait_time,
+							  std::shared_ptr<streamfx::util::profiler> run_time)
 {
-	std::shared_ptr<streamfx::util::threadpool::task> local_work{};
-	uint32_t                                          local_number = _worker_idx.fetch_add(1);
+	char buffer[256];
+	int  length = snprintf(buffer, sizeof(buffer), "  %-20s: %10" PRIu64 " %10" PRIu64 " %10" PRIu64, name, executed,
+						   dropped, killed);
+	if (wait_time && run_time && (wait_time->count() > 0) && (run_time->count() > 0)) {
+		snprintf(buffer + length, sizeof(buffer) - static_cast<size_t>(length),
+				 " %8" PRId64 "µs %8" PRId64 "µs %8" PRId64 "µs %8" PRId64 "µs",
+				 static_cast<int64_t>(wait_time->average_duration() / 1000.0),
+				 static_cast<int64_t>(
+					 std::chrono::duration_cast<std::chrono::microseconds>(wait_time->percentile(0.99)).count()),
+				 static_cast<int64_t>(run_time->average_duration() / 1000.0),
+				 static_cast<int64_t>(
+					 std::chrono::duration_cast<std::chrono::microseconds>(run_time->percentile(0.99)).count()));
+	}
+	text += buffer;
+	text += "\n";
+}
 
-	while (!_worker_stop) {
-		// Wait for more work, or immediately continue if there is still work to do.
-		{
-			// Lock the tasks mutex to check for work.
-			std::unique_lock<std::mutex> lock(_tasks_lock);
+std::string streamfx::util::threadpool::statistics_report()
+{
+	static const char* lanes[priorities] = {"Realtime", "Normal", "Background"};
+
+	std::string text;
+	char        buffer[256];
 
-			// If there are currently no tasks queued, wait on the condition variable.
-			// This temporarily unlocks the mutex until it is woken up.
-			if (_tasks.size() == 0) {
-				_tasks_cv.wait(lock, [this]() { return _worker_stop || _tasks.size() > 0; });
+	snprintf(buffer, sizeof(buffer), "%-22s: %10s %10s\n", "Lane", "Queued", "Peak");
+	text += buffer;
+	for (std::size_t lane = 0; lane < priorities; lane++) {
+		snprintf(buffer, sizeof(buffer), "  %-20s: %10zu %10zu\n", lanes[lane], _tasks_queued[lane].load(),
+				 _tasks_peak[lane].load());
+		text += buffer;
+	}
+
+	snprintf(buffer, sizeof(buffer), "%-22s: %10s %10s %10s %10s %10s %10s %10s\n", "Worker / Label", "Executed",
+			 "Dropped", "Killed", "Wait", "Wait 99%", "Run", "Run 99%");
+	text += buffer;
+	for (std::size_t index = 0; index < _workers.size(); index++) {
+		auto& stats = _workers[index]->stats;
+		snprintf(buffer, sizeof(buffer), "%s %zu", _workers[index]->background ? "Background" : "Worker", index);
+		format_statistics(text, buffer, stats.executed.load(), stats.dropped.load(), stats.killed.load(),
+						  stats.wait_time, stats.run_time);
+	}
+	{
+		std::unique_lock<std::mutex> lock(_labels_lock);
+		for (auto& kv : _labels) {
+			std::string name{kv.first};
+			format_statistics(text, name.c_str(), kv.second->executed.load(), kv.second->dropped.load(),
+							  kv.second->killed.load(), kv.second->wait_time, kv.second->run_time);
+		}
+	}
+
+	return text;
+}
+
+std::shared_ptr<::streamfx::util::threadpool::task_group> streamfx::util::threadpool::create_group()
+{
+	return std::make_shared<streamfx::util::threadpool::task_group>(this);
+}
+
+void streamfx::util::threadpool::parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+											  std::function<void(std::size_t, std::size_t)> fn,
+											  threadpool_priority                           priority)
+{
+	if (end <= begin) {
+		return;
+	}
+
+	grain              = std::max<std::size_t>(grain, 1);
+	std::size_t chunks = (end - begin + grain - 1) / grain;
+
+	// Not worth the overhead of waking up anyone else.
+	if (chunks == 1) {
+		fn(begin, end);
+		return;
+	}
+
+	struct state_t {
+		std::function<void(std::size_t, std::size_t)> function;
+		std::size_t                                   begin;
+		std::size_t                                   end;
+		std::size_t                                   grain;
+		std::size_t                                   chunks;
+		std::atomic<std::size_t>                      next;
+		std::atomic<std::size_t>                      done;
+		std::exception_ptr                            error;
+		std::mutex                                    lock;
+		std::condition_variable                       cv;
+	};
+	auto state      = std::make_shared<state_t>();
+	state->function = fn;
+	state->begin    = begin;
+	state->end      = end;
+	state->grain    = grain;
+	state->chunks   = chunks;
+	state->next     = 0;
+	state->done     = 0;
+
+	// Claims chunks until there are none left. Helpers that start late simply find nothing to do, so the caller
+	// never has to wait for a helper to actually be scheduled.
+	auto run = [](std::shared_ptr<state_t> state) {
+		for (std::size_t chunk = state->next.fetch_add(1); chunk < state->chunks; chunk = state->next.fetch_add(1)) {
+			std::size_t finished = 1;
+			try {
+				std::size_t chunk_begin = state->begin + chunk * state->grain;
+				state->function(chunk_begin, std::min(chunk_begin + state->grain, state->end));
+			} catch (...) {
+				std::unique_lock<std::mutex> lock(state->lock);
+				if (!state->error) {
+					state->error = std::current_exception();
+				}
+
+				// Abandon all chunks nobody claimed yet, and count them as done.
+				std::size_t claimed = state->next.exchange(state->chunks);
+				if (claimed < state->chunks) {
+					finished += state->chunks - claimed;
+				}
 			}
 
-			// If there is either no tasks or we were asked to stop, skip everything.
-			if (_worker_stop || (_tasks.size() == 0)) {
-				continue;
+			if ((state->done.fetch_add(finished) + finished) == state->chunks) {
+				std::unique_lock<std::mutex> lock(state->lock);
+				state->cv.notify_all();
 			}
+		}
+	};
+
+	// Ask for at most one helper per worker, the calling thread does its own share.
+	std::size_t                                                    helpers = std::min(chunks - 1, _settings.workers);
+	std::vector<std::shared_ptr<streamfx::util::threadpool::task>> tasks;
+	tasks.reserve(helpers);
+	for (std::size_t n = 0; n < helpers; n++) {
+		tasks.push_back(push([run](threadpool_data_t data) { run(std::static_pointer_cast<state_t>(data)); }, state,
+							 priority));
+	}
+	run(state);
+
+	{ // Wait for chunks that are still being worked on by helpers.
+		std::unique_lock<std::mutex> lock(state->lock);
+		state->cv.wait(lock, [&state]() { return state->done.load() == state->chunks; });
+	}
+
+	// Helpers that did not start yet have nothing left to do.
+	for (auto& task : tasks) {
+		pop(task);
+	}
+
+	if (state->error) {
+		std::rethrow_exception(state->error);
+	}
+}
+
+void streamfx::util::threadpool::enqueue(std::shared_ptr<::streamfx::util::threadpool::task> task)
+{
+	auto lane = static_cast<std::size_t>(task->_priority);
+
+	// Workers queue follow-up work on their own queue, everyone else spreads it over all queues.
+	std::size_t index;
+	if (local_pool == this) {
+		index = local_index;
+	} else {
+		index = static_cast<std::size_t>(_worker_idx.fetch_add(1)) % _workers.size();
+	}
+
+	{
+		// Recycled tasks must not carry a stale queue time into the statistics.
+		task->_queued_at = streamfx::util::profiler::is_enabled() ? std::chrono::steady_clock::now()
+																  : threadpool_deadline_t();
 
-			// Grab the latest task and immediately remove it from the queue.
-			local_work = _tasks.front();
-			_tasks.pop_front();
+		auto&                        queue = _workers[index];
+		std::unique_lock<std::mutex> lock(queue->tasks_lock);
+
+		// Count the task before anyone can see it, as a thief may take it the moment it is in the queue.
+		std::size_t depth = _tasks_queued[lane].fetch_add(1) + 1;
+		queue->tasks[lane].push_back(std::move(task));
+
+		// Remember the deepest the lane ever was, which tells more about bursts than the current depth.
+		std::size_t peak = _tasks_peak[lane].load(std::memory_order_relaxed);
+		while ((depth > peak) && !_tasks_peak[lane].compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {
+		}
+	}
+
+	wake(lane);
+}
+
+void streamfx::util::threadpool::wake(std::size_t lane)
+{
+	// Only touch the shared lock if there actually is someone to wake up.
+	if ((_settings.background_workers > 0) && (lane == static_cast<std::size_t>(threadpool_priority::BACKGROUND))) {
+		if (_background_sleeping.load() > 0) {
+			std::unique_lock<std::mutex> lock(_tasks_lock);
+			_background_cv.notify_one();
+		}
+	} else if (_worker_sleeping.load() > 0) {
+		std::unique_lock<std::mutex> lock(_tasks_lock);
+		_tasks_cv.notify_one();
+	}
+}
+
+bool streamfx::util::threadpool::timer_order(const std::shared_ptr<::streamfx::util::threadpool::task>& a,
+											 const std::shared_ptr<::streamfx::util::threadpool::task>& b)
+{
+	return a->_due > b->_due;
+}
+
+void streamfx::util::threadpool::arm(std::shared_ptr<::streamfx::util::threadpool::task> task)
+{
+	auto                         key = task.get();
+	std::unique_lock<std::mutex> lock(_timer_lock);
+	_timer_tasks.push_back(std::move(task));
+	std::push_heap(_timer_tasks.begin(), _timer_tasks.end(), timer_order);
+
+	// The timer only needs to wake up if this task is now the next one to become due.
+	if (_timer_tasks.front().get() == key) {
+		_timer_cv.notify_one();
+	}
+}
+
+void streamfx::util::threadpool::timer()
+{
+	std::unique_lock<std::mutex> lock(_timer_lock);
+	while (!_worker_stop) {
+		if (_timer_tasks.empty()) {
+			_timer_cv.wait(lock);
+			continue;
 		}
 
-		// If the task was killed, skip everything again.
-		if (local_work->_is_dead) {
+		if (auto due = _timer_tasks.front()->_due; std::chrono::steady_clock::now() < due) {
+			_timer_cv.wait_until(lock, due);
 			continue;
 		}
 
+		std::pop_heap(_timer_tasks.begin(), _timer_tasks.end(), timer_order);
+		auto task = std::move(_timer_tasks.back());
+		_timer_tasks.pop_back();
+
+		// Tasks that were killed while waiting are simply forgotten.
+		if (!task->_is_dead) {
+			lock.unlock();
+			enqueue(std::move(task));
+			lock.lock();
+		}
+	}
+}
+
+void streamfx::util::threadpool::work(std::size_t index)
+{
+	std::shared_ptr<streamfx::util::threadpool::task> local_work{};
+
+	local_pool  = this;
+	local_index = index;
+
+	bool background = _workers[index]->background;
+	apply_layout(index, background ? _settings.background_affinity : _settings.affinity,
+				 background && _settings.background_idle);
+
+	while (!_worker_stop) {
+		local_work = find_work(index);
+
+		// If there is no work we are allowed to do, go to sleep until that changes.
+		if (!local_work) {
+			auto& sleeping = background ? _background_sleeping : _worker_sleeping;
+			auto& cv       = background ? _background_cv : _tasks_cv;
+
+			std::unique_lock<std::mutex> lock(_tasks_lock);
+			sleeping.fetch_add(1);
+			cv.wait(lock, [this, index]() { return _worker_stop || has_work(index); });
+			sleeping.fetch_sub(1);
+			continue;
+		}
+
+		auto& worker_stats = _workers[index]->stats;
+		auto* label_stats  = local_work->_statistics;
+
+		// Skip tasks that were killed, or that would now run too late to be of any use.
+		bool is_alive = !local_work->_is_dead;
+		if (!is_alive) {
+			worker_stats.killed.fetch_add(1, std::memory_order_relaxed);
+			if (label_stats) {
+				label_stats->killed.fetch_add(1, std::memory_order_relaxed);
+			}
+		} else if (local_work->_deadline != threadpool_deadline_t::max()) {
+			if (std::chrono::steady_clock::now() > local_work->_deadline) {
+				D_LOG_DEBUG("Worker %" PRIx32 " dropped task (%" PRIxPTR ") as it missed its deadline.",
+							static_cast<uint32_t>(index), reinterpret_cast<ptrdiff_t>(local_work.get()));
+				is_alive = false;
+				worker_stats.dropped.fetch_add(1, std::memory_order_relaxed);
+				if (label_stats) {
+					label_stats->dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		}
+
 		// Try to execute work, but don't crash on catchable exceptions.
-		if (local_work->_callback) {
+		if (is_alive && local_work->_invoke) {
+			bool profile = streamfx::util::profiler::is_enabled();
+			bool measure = profile || streamfx::util::profiler::is_tracing();
+
+			threadpool_deadline_t started;
+			if (measure) {
+				started = std::chrono::steady_clock::now();
+			}
+			if (profile && (local_work->_queued_at != threadpool_deadline_t())) {
+				worker_stats.wait_time->track(started - local_work->_queued_at);
+				if (label_stats) {
+					label_stats->wait_time->track(started - local_work->_queued_at);
+				}
+			}
+
 			try {
-				local_work->_callback(local_work->_data);
+				local_work->_invoke(local_work->_callable, local_work->_data);
 			} catch (std::exception const& ex) {
 				D_LOG_WARNING("Worker %" PRIx32 " caught exception from task (%" PRIxPTR ", %" PRIxPTR
 							  ") with message: %s",
-							  local_number, reinterpret_cast<ptrdiff_t>(local_work->_callback.target<void>()),
+							  static_cast<uint32_t>(index),
+							  reinterpret_cast<ptrdiff_t>(local_work->_callable),
 							  reinterpret_cast<ptrdiff_t>(local_work->_data.get()), ex.what());
 			} catch (...) {
 				D_LOG_WARNING("Worker %" PRIx32 " caught exception of unknown type from task (%" PRIxPTR ", %" PRIxPTR
 							  ").",
-							  local_number, reinterpret_cast<ptrdiff_t>(local_work->_callback.target<void>()),
+							  static_cast<uint32_t>(index),
+							  reinterpret_cast<ptrdiff_t>(local_work->_callable),
 							  reinterpret_cast<ptrdiff_t>(local_work->_data.get()));
 			}
+
+			worker_stats.executed.fetch_add(1, std::memory_order_relaxed);
+			if (label_stats) {
+				label_stats->executed.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (measure) {
+				auto finished = std::chrono::steady_clock::now();
+				if (profile) {
+					worker_stats.run_time->track(finished - started);
+					if (label_stats) {
+						label_stats->run_time->track(finished - started);
+					}
+				}
+				streamfx::util::profiler::trace(label_stats ? label_stats->name : "Task", started, finished);
+			}
+		}
+
+		// Let the group know that this task is done, no matter if it ran or not.
+		if (local_work->_group) {
+			local_work->_group->complete();
+		}
+
+		// Repeating tasks go back to the timer, unless they were killed in the meantime.
+		if ((local_work->_interval.count() > 0) && !local_work->_is_dead) {
+			auto now = std::chrono::steady_clock::now();
+			local_work->_due += local_work->_interval;
+			if (local_work->_due < now) {
+				local_work->_due = now + local_work->_interval;
+			}
+			arm(local_work);
+		}
+
+		// Give up our background slot, and wake up someone if a background task was waiting for it.
+		if (local_work->_priority == threadpool_priority::BACKGROUND) {
+			_background_active.fetch_sub(1);
+			if (_tasks_queued[static_cast<std::size_t>(threadpool_priority::BACKGROUND)].load() > 0) {
+				wake(static_cast<std::size_t>(threadpool_priority::BACKGROUND));
+			}
 		}
 
 		// Remove our reference to the work unit.
 		local_work.reset();
 	}
 
-	_worker_idx.fetch_sub(1);
+	local_pool = nullptr;
+}
+
+bool streamfx::util::threadpool::has_work(std::size_t index)
+{
+	constexpr auto realtime   = static_cast<std::size_t>(threadpool_priority::REALTIME);
+	constexpr auto normal     = static_cast<std::size_t>(threadpool_priority::NORMAL);
+	constexpr auto background = static_cast<std::size_t>(threadpool_priority::BACKGROUND);
+
+	bool has_background = (_tasks_queued[background].load() > 0) && (_background_active.load() < _background_limit);
+	if (_workers[index]->background) {
+		return has_background;
+	} else if (_settings.background_workers > 0) {
+		return (_tasks_queued[realtime].load() > 0) || (_tasks_queued[normal].load() > 0);
+	} else {
+		return (_tasks_queued[realtime].load() > 0) || (_tasks_queued[normal].load() > 0) || has_background;
+	}
+}
+
+std::shared_ptr<::streamfx::util::threadpool::task> streamfx::util::threadpool::find_work(std::size_t index)
+{
+	constexpr auto background = static_cast<std::size_t>(threadpool_priority::BACKGROUND);
+
+	// Dedicated background workers only look at the background lane, and regular workers leave it to them.
+	std::size_t first = 0;
+	std::size_t last  = priorities;
+	if (_workers[index]->background) {
+		first = background;
+	} else if (_settings.background_workers > 0) {
+		last = background;
+	}
+
+	for (std::size_t lane = first; lane < last; lane++) {
+		if (_tasks_queued[lane].load() == 0) {
+			continue;
+		}
+
+		// Reserve a background slot before looking for background work.
+		if (lane == background) {
+			std::size_t active = _background_active.load();
+			do {
+				if (active >= _background_limit) {
+					return nullptr;
+				}
+			} while (!_background_active.compare_exchange_weak(active, active + 1));
+		}
+
+		// Visit our own queue first, then every other queue, starting with our neighbour so that thieves spread
+		// out. The owner takes the oldest task, while thieves take from the back to stay out of its way.
+		for (std::size_t n = 0; n < _workers.size(); n++) {
+			auto&                        queue = _workers[(index + n) % _workers.size()];
+			std::unique_lock<std::mutex> lock(queue->tasks_lock);
+			auto&                        tasks = queue->tasks[lane];
+			if (tasks.size() > 0) {
+				auto task = (n == 0) ? tasks.pop_front() : tasks.pop_back();
+				_tasks_queued[lane].fetch_sub(1);
+				return task;
+			}
+		}
+
+		// Someone else was faster, give the slot back.
+		if (lane == background) {
+			_background_active.fetch_sub(1);
+		}
+	}
+
+	return nullptr;
+}
+
+streamfx::util::threadpool::task::task()
+	: _is_dead(false), _data(), _priority(threadpool_priority::NORMAL), _deadline(threadpool_deadline_t::max()),
+	  _queued_at(), _statistics(nullptr), _due(), _interval(0), _group(), _callable(nullptr), _invoke(nullptr),
+	  _destroy(nullptr)
+{}
+
+streamfx::util::threadpool::task::~task()
+{
+	if (_destroy) {
+		_destroy(_callable);
+	}
+}
+
+streamfx::util::threadpool::task_group::task_group(threadpool* pool)
+	: _pool(pool), _lock(), _cv(), _pending(0), _continuations()
+{}
+
+streamfx::util::threadpool::task_group::~task_group() {}
+
+std::shared_ptr<::streamfx::util::threadpool::task>
+	streamfx::util::threadpool::task_group::push(threadpool_callback_t fn, threadpool_data_t data,
+												 threadpool_priority priority, threadpool_deadline_t deadline,
+												 const char* label)
+{
+	auto task    = _pool->create(fn, data, priority, deadline);
+	task->_group = shared_from_this();
+	if (label) {
+		task->_statistics = _pool->find_statistics(label);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		_pending++;
+	}
+	_pool->enqueue(task);
+
+	return task;
+}
+
+void streamfx::util::threadpool::task_group::then(threadpool_callback_t fn, threadpool_data_t data,
+												  threadpool_priority priority)
+{
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (_pending > 0) {
+			_continuations.push_back({fn, data, priority});
+			return;
+		}
+	}
+
+	// Everything is already done, so continue right away.
+	_pool->push(fn, data, priority);
+}
+
+void streamfx::util::threadpool::task_group::wait()
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	_cv.wait(lock, [this]() { return _pending == 0; });
+}
+
+bool streamfx::util::threadpool::task_group::wait_until(threadpool_deadline_t deadline)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	return _cv.wait_until(lock, deadline, [this]() { return _pending == 0; });
+}
+
+bool streamfx::util::threadpool::task_group::empty()
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	return _pending == 0;
+}
+
+void streamfx::util::threadpool::task_group::complete()
+{
+	std::vector<continuation> continuations;
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (--_pending > 0) {
+			return;
+		}
+		continuations.swap(_continuations);
+		_cv.notify_all();
+	}
+
+	for (auto& entry : continuations) {
+		_pool->push(entry.callback, entry.data, entry.priority);
+	}
 }
 
-streamfx::util::threadpool::task::task() {}
+// Finished tasks kept around for reuse, anything above this is returned to the global allocator.
+#define ST_FREELIST_LIMIT 1024
 
-streamfx::util::threadpool::task::task(threadpool_callback_t fn, threadpool_data_t dt)
-	: _is_dead(false), _callback(fn), _data(dt)
+streamfx::util::threadpool::task_freelist::task_freelist()
+	: _lock(), _head(nullptr), _count(0), _block_size(0), _allocations(0)
 {}
+
+streamfx::util::threadpool::task_freelist::~task_freelist()
+{
+	while (_head) {
+		void* next = *reinterpret_cast<void**>(_head);
+		::operator delete(_head);
+		_head = next;
+	}
+}
+
+void* streamfx::util::threadpool::task_freelist::allocate(std::size_t size)
+{
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (_block_size == 0) {
+			// All tasks share the same type, so the first allocation decides the size of every block.
+			_block_size = size;
+		}
+		if ((size == _block_size) && _head) {
+			void* block = _head;
+			_head       = *reinterpret_cast<void**>(block);
+			_count--;
+			return block;
+		}
+	}
+
+	_allocations.fetch_add(1);
+	return ::operator new(size);
+}
+
+void streamfx::util::threadpool::task_freelist::deallocate(void* block, std::size_t size)
+{
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if ((size == _block_size) && (size >= sizeof(void*)) && (_count < ST_FREELIST_LIMIT)) {
+			*reinterpret_cast<void**>(block) = _head;
+			_head                            = block;
+			_count++;
+			return;
+		}
+	}
+
+	::operator delete(block);
+}
+
+uint64_t streamfx::util::threadpool::task_freelist::allocations()
+{
+	return _allocations.load();
+}
+
+// Initial capacity of each queue, must be a power of two.
+#define ST_QUEUE_CAPACITY 32
+
+streamfx::util::threadpool::task_queue::task_queue() : _tasks(ST_QUEUE_CAPACITY), _head(0), _size(0) {}
+
+std::size_t streamfx::util::threadpool::task_queue::size()
+{
+	return _size;
+}
+
+void streamfx::util::threadpool::task_queue::push_back(std::shared_ptr<::streamfx::util::threadpool::task> task)
+{
+	if (_size == _tasks.size()) {
+		// Out of space, so unroll the ring into a buffer twice the size.
+		std::vector<std::shared_ptr<::streamfx::util::threadpool::task>> tasks(_tasks.size() * 2);
+		for (std::size_t idx = 0; idx < _size; idx++) {
+			tasks[idx] = std::move(_tasks[(_head + idx) & (_tasks.size() - 1)]);
+		}
+		_tasks.swap(tasks);
+		_head = 0;
+	}
+
+	_tasks[(_head + _size) & (_tasks.size() - 1)] = std::move(task);
+	_size++;
+}
+
+std::shared_ptr<::streamfx::util::threadpool::task> streamfx::util::threadpool::task_queue::pop_front()
+{
+	auto task = std::move(_tasks[_head]);
+	_head     = (_head + 1) & (_tasks.size() - 1);
+	_size--;
+	return task;
+}
+
+std::shared_ptr<::streamfx::util::threadpool::task> streamfx::util::threadpool::task_queue::pop_back()
+{
+	_size--;
+	return std::move(_tasks[(_head + _size) & (_tasks.size() - 1)]);
+}
@@ -18,52 +18,435 @@
  */
 
 #pragma once
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
-#include <list>
+#include <future>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 namespace streamfx::util {
+	class profiler;
+
 	typedef std::shared_ptr<void>                  threadpool_data_t;
 	typedef std::function<void(threadpool_data_t)> threadpool_callback_t;
+	typedef std::chrono::steady_clock::time_point  threadpool_deadline_t;
+
+	enum class threadpool_priority : uint8_t {
+		REALTIME   = 0, // Work that a frame is waiting on, runs before anything else.
+		NORMAL     = 1, // Everything else.
+		BACKGROUND = 2, // Slow work (IO, model loading, ...), never occupies all workers at once.
+	};
+
+	/** Layout of the workers in a threadpool.
+	 */
+	struct threadpool_settings {
+		// Number of workers for realtime and normal tasks, 0 picks a number based on the available cores.
+		std::size_t workers = 0;
+
+		// Number of workers dedicated to background tasks. If 0, background tasks share the regular workers.
+		std::size_t background_workers = 0;
+
+		// Cores that regular workers may run on, empty to let the operating system decide.
+		std::vector<std::size_t> affinity;
+
+		// Cores that dedicated background workers may run on, empty to let the operating system decide.
+		std::vector<std::size_t> background_affinity;
+
+		// Run dedicated background workers in the lowest scheduling class (SCHED_IDLE, background mode on Windows).
+		bool background_idle = false;
+	};
 
 	class threadpool {
 		public:
+		class task_group;
+
+		private:
+		/** Counters kept for every worker and every task label.
+		 */
+		struct statistics {
+			const char*           name = nullptr;
+			std::atomic<uint64_t> executed{0};
+			std::atomic<uint64_t> dropped{0}; // Missed their deadline.
+			std::atomic<uint64_t> killed{0};  // Marked dead through pop() before they ran.
+
+			// Time spent in the queue, and time spent running. Only tracked if profiling is enabled.
+			std::shared_ptr<::streamfx::util::profiler> wait_time;
+			std::shared_ptr<::streamfx::util::profiler> run_time;
+		};
+
+		public:
+
 		class task {
+			public:
+			// Callables up to this size are stored inside the task itself instead of on the heap. This covers small
+			// lambdas, as well as std::bind with a member function and an instance.
+			static constexpr std::size_t inline_size = 64;
+
+			template<typename _callback>
+			static constexpr bool is_inline()
+			{
+				return (sizeof(_callback) <= inline_size) && (alignof(_callback) <= alignof(std::max_align_t));
+			}
+
 			protected:
 			std::atomic_bool      _is_dead;
-			threadpool_callback_t _callback;
 			threadpool_data_t     _data;
+			threadpool_priority   _priority;
+			threadpool_deadline_t _deadline;
+			threadpool_deadline_t _queued_at;
+			statistics*           _statistics;
+
+			// Timed tasks wait for _due before they are queued. Repeating tasks also have an _interval.
+			threadpool_deadline_t    _due;
+			std::chrono::nanoseconds _interval;
+
+			std::shared_ptr<::streamfx::util::threadpool::task_group> _group;
+
+			alignas(std::max_align_t) uint8_t _storage[inline_size];
+			void*                             _callable;
+			void (*_invoke)(void* callable, threadpool_data_t& data);
+			void (*_destroy)(void* callable);
 
 			public:
 			task();
-			task(threadpool_callback_t callback_function, threadpool_data_t data);
+			~task();
+
+			template<typename _callback>
+			task(_callback&& callback_function, threadpool_data_t data, threadpool_priority priority,
+				 threadpool_deadline_t deadline)
+				: _is_dead(false), _data(std::move(data)), _priority(priority), _deadline(deadline), _queued_at(),
+				  _statistics(nullptr), _due(), _interval(0), _group(), _callable(nullptr), _invoke(nullptr),
+				  _destroy(nullptr)
+			{
+				typedef typename std::decay<_callback>::type callback_t;
+
+				if constexpr (is_inline<callback_t>()) {
+					_callable = new (_storage) callback_t(std::forward<_callback>(callback_function));
+					_destroy  = [](void* callable) { static_cast<callback_t*>(callable)->~callback_t(); };
+				} else {
+					_callable = new callback_t(std::forward<_callback>(callback_function));
+					_destroy  = [](void* callable) { delete static_cast<callback_t*>(callable); };
+				}
+				_invoke = [](void* callable, threadpool_data_t& data) { (*static_cast<callback_t*>(callable))(data); };
+			}
+
+			friend class streamfx::util::threadpool;
+		};
+
+		/** A set of tasks that can be waited on, or continued from, as a whole.
+		 *
+		 * Tasks count as finished once they were executed, killed or dropped for missing their deadline.
+		 */
+		class task_group : public std::enable_shared_from_this<streamfx::util::threadpool::task_group> {
+			struct continuation {
+				threadpool_callback_t callback;
+				threadpool_data_t     data;
+				threadpool_priority   priority;
+			};
+
+			threadpool*               _pool;
+			std::mutex                _lock;
+			std::condition_variable   _cv;
+			std::size_t               _pending;
+			std::vector<continuation> _continuations;
+
+			public:
+			task_group(threadpool* pool);
+			~task_group();
+
+			std::shared_ptr<::streamfx::util::threadpool::task>
+				push(threadpool_callback_t callback_function, threadpool_data_t data,
+					 threadpool_priority   priority = threadpool_priority::NORMAL,
+					 threadpool_deadline_t deadline = threadpool_deadline_t::max(), const char* label = nullptr);
+
+			/** Queue a task that runs once all tasks in this group have finished.
+			 */
+			void then(threadpool_callback_t callback_function, threadpool_data_t data,
+					  threadpool_priority priority = threadpool_priority::NORMAL);
+
+			/** Block until all tasks in this group have finished.
+			 *
+			 * Do not call this from inside a task of the same pool, unless the pool is guaranteed to have a free
+			 * worker for the tasks of this group.
+			 */
+			void wait();
+
+			bool wait_until(threadpool_deadline_t deadline);
+
+			bool empty();
+
+			private:
+			void complete();
 
 			friend class streamfx::util::threadpool;
 		};
 
 		private:
-		std::list<std::thread>                                         _workers;
-		std::atomic_bool                                               _worker_stop;
-		std::atomic<uint32_t>                                          _worker_idx;
-		std::list<std::shared_ptr<::streamfx::util::threadpool::task>> _tasks;
-		std::mutex                                                     _tasks_lock;
-		std::condition_variable                                        _tasks_cv;
+		static constexpr std::size_t priorities = 3;
+
+		/** Recycles the memory of finished tasks, so that submitting tasks does not need the global allocator once
+		 * the pool has warmed up.
+		 */
+		class task_freelist {
+			std::mutex            _lock;
+			void*                 _head;
+			std::size_t           _count;
+			std::size_t           _block_size;
+			std::atomic<uint64_t> _allocations;
+
+			public:
+			task_freelist();
+			~task_freelist();
+
+			void* allocate(std::size_t size);
+
+			void deallocate(void* block, std::size_t size);
+
+			uint64_t allocations();
+		};
+
+		template<typename T>
+		class task_allocator {
+			public:
+			typedef T value_type;
+
+			std::shared_ptr<task_freelist> _freelist;
+
+			task_allocator(std::shared_ptr<task_freelist> freelist) : _freelist(freelist) {}
+
+			template<typename U>
+			task_allocator(const task_allocator<U>& other) : _freelist(other._freelist)
+			{}
+
+			T* allocate(std::size_t count)
+			{
+				return static_cast<T*>(_freelist->allocate(sizeof(T) * count));
+			}
+
+			void deallocate(T* block, std::size_t count)
+			{
+				_freelist->deallocate(block, sizeof(T) * count);
+			}
+
+			template<typename U>
+			bool operator==(const task_allocator<U>& other) const
+			{
+				return _freelist == other._freelist;
+			}
+
+			template<typename U>
+			bool operator!=(const task_allocator<U>& other) const
+			{
+				return _freelist != other._freelist;
+			}
+		};
+
+		/** Ring buffer of tasks, which only allocates memory when it has to grow.
+		 */
+		class task_queue {
+			std::vector<std::shared_ptr<::streamfx::util::threadpool::task>> _tasks;
+			std::size_t                                                     _head;
+			std::size_t                                                     _size;
+
+			public:
+			task_queue();
+
+			std::size_t size();
+
+			void push_back(std::shared_ptr<::streamfx::util::threadpool::task> task);
+
+			std::shared_ptr<::streamfx::util::threadpool::task> pop_front();
+
+			std::shared_ptr<::streamfx::util::threadpool::task> pop_back();
+		};
+
+		struct worker {
+			std::thread                        thread;
+			bool                               background;
+			std::array<task_queue, priorities> tasks;
+			std::mutex                         tasks_lock;
+			statistics                         stats;
+		};
+
+		threadpool_settings                         _settings;
+		std::vector<std::unique_ptr<worker>>        _workers;
+		std::atomic_bool                            _worker_stop;
+		std::atomic<uint32_t>                       _worker_idx;
+		std::atomic<size_t>                         _worker_sleeping;
+		std::array<std::atomic<size_t>, priorities> _tasks_queued;
+		std::array<std::atomic<size_t>, priorities> _tasks_peak;
+		std::mutex                                  _tasks_lock;
+		std::condition_variable                     _tasks_cv;
+		std::atomic<size_t>                         _background_sleeping;
+		std::condition_variable                     _background_cv;
+		std::atomic<size_t>                         _background_active;
+		size_t                                      _background_limit;
+		std::shared_ptr<task_freelist>              _freelist;
+		std::atomic<uint64_t>                       _allocations;
+
+		std::mutex                                              _labels_lock;
+		std::map<std::string_view, std::unique_ptr<statistics>> _labels;
+
+		// Timed tasks, as a heap ordered by the time they are due.
+		std::thread                                                      _timer;
+		std::mutex                                                       _timer_lock;
+		std::condition_variable                                          _timer_cv;
+		std::vector<std::shared_ptr<::streamfx::util::threadpool::task>> _timer_tasks;
 
 		public:
-		threadpool();
+		threadpool(threadpool_settings settings = threadpool_settings());
 		~threadpool();
 
-		std::shared_ptr<::streamfx::util::threadpool::task> push(threadpool_callback_t callback_function,
-																 threadpool_data_t     data);
+		/** The layout that the pool actually ended up with, with automatic values resolved.
+		 */
+		const threadpool_settings& layout();
+
+		/** Queue a new task.
+		 *
+		 * @param priority Lane to queue the task in, higher lanes are always drained first.
+		 * @param deadline Point in time after which the task is dropped instead of executed.
+		 * @param label    Name to group statistics under, must remain valid for the lifetime of the pool.
+		 */
+		template<typename _callback>
+		std::shared_ptr<::streamfx::util::threadpool::task>
+			push(_callback&& callback_function, threadpool_data_t data,
+				 threadpool_priority   priority = threadpool_priority::NORMAL,
+				 threadpool_deadline_t deadline = threadpool_deadline_t::max(), const char* label = nullptr)
+		{
+			auto task = create(std::forward<_callback>(callback_function), std::move(data), priority, deadline);
+			if (label) {
+				task->_statistics = find_statistics(label);
+			}
+			enqueue(task);
+			return task;
+		}
+
+		/** Queue a new task once the given point in time has been reached.
+		 *
+		 * The task is only queued at that time, so it still has to wait for a free worker like any other task.
+		 */
+		template<typename _callback>
+		std::shared_ptr<::streamfx::util::threadpool::task>
+			schedule_at(_callback&& callback_function, threadpool_data_t data, threadpool_deadline_t when,
+						threadpool_priority priority = threadpool_priority::NORMAL, const char* label = nullptr)
+		{
+			auto task  = create(std::forward<_callback>(callback_function), std::move(data), priority,
+								threadpool_deadline_t::max());
+			task->_due = when;
+			if (label) {
+				task->_statistics = find_statistics(label);
+			}
+			arm(task);
+			return task;
+		}
+
+		/** Queue a task every interval, starting one interval from now, until it is killed with pop().
+		 *
+		 * A task is never queued again while it is still waiting or running. Runs that were missed because of that are
+		 * skipped, instead of being caught up on.
+		 */
+		template<typename _callback>
+		std::shared_ptr<::streamfx::util::threadpool::task>
+			schedule_every(_callback&& callback_function, threadpool_data_t data, std::chrono::nanoseconds interval,
+						   threadpool_priority priority = threadpool_priority::NORMAL, const char* label = nullptr)
+		{
+			auto task       = create(std::forward<_callback>(callback_function), std::move(data), priority,
+									 threadpool_deadline_t::max());
+			task->_interval = std::max<std::chrono::nanoseconds>(interval, std::chrono::nanoseconds(1));
+			task->_due      = std::chrono::steady_clock::now() + task->_interval;
+			if (label) {
+				task->_statistics = find_statistics(label);
+			}
+			arm(task);
+			return task;
+		}
 
 		void pop(std::shared_ptr<::streamfx::util::threadpool::task> work);
 
+		std::shared_ptr<::streamfx::util::threadpool::task_group> create_group();
+
+		/** Queue a callable and retrieve its result through a future.
+		 */
+		template<typename _function>
+		auto async(_function&& function, threadpool_priority priority = threadpool_priority::NORMAL)
+			-> std::future<decltype(function())>
+		{
+			typedef decltype(function()) result_t;
+
+			auto work   = std::make_shared<std::packaged_task<result_t()>>(std::forward<_function>(function));
+			auto result = work->get_future();
+			push([work](threadpool_data_t) { (*work)(); }, nullptr, priority);
+			return result;
+		}
+
+		/** Split the range [begin, end) into chunks of at most grain elements and run them in parallel.
+		 *
+		 * The calling thread works on chunks too, so this makes progress even if every worker is busy, and may be
+		 * called from inside a task. Returns once every chunk is done, and rethrows the first exception thrown by
+		 * any chunk.
+		 *
+		 * @param function Called with the [begin, end) range of a single chunk.
+		 */
+		void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+						  std::function<void(std::size_t begin, std::size_t end)> function,
+						  threadpool_priority priority = threadpool_priority::REALTIME);
+
+		/** Number of times that submitting a task had to fall back to the global allocator.
+		 *
+		 * This stops growing once the pool has warmed up, unless callables are too large to be stored inline.
+		 */
+		uint64_t allocations();
+
+		/** Format queue depths, and the counters and timings of every worker and label as a table.
+		 *
+		 * Timings are only available for tasks that were queued and run while profiling was enabled.
+		 */
+		std::string statistics_report();
+
 		private:
-		void work();
+		template<typename _callback>
+		std::shared_ptr<::streamfx::util::threadpool::task> create(_callback&& callback_function,
+																   threadpool_data_t data, threadpool_priority priority,
+																   threadpool_deadline_t deadline)
+		{
+			if constexpr (!task::is_inline<typename std::decay<_callback>::type>()) {
+				_allocations.fetch_add(1);
+			}
+
+			return std::allocate_shared<::streamfx::util::threadpool::task>(
+				task_allocator<::streamfx::util::threadpool::task>(_freelist),
+				std::forward<_callback>(callback_function), std::move(data), priority, deadline);
+		}
+
+		void enqueue(std::shared_ptr<::streamfx::util::threadpool::task> task);
+
+		statistics* find_statistics(const char* label);
+
+		void wake(std::size_t lane);
+
+		static bool timer_order(const std::shared_ptr<::streamfx::util::threadpool::task>& a,
+								const std::shared_ptr<::streamfx::util::threadpool::task>& b);
+
+		void arm(std::shared_ptr<::streamfx::util::threadpool::task> task);
+
+		void timer();
+
+		void work(size_t index);
+
+		bool has_work(std::size_t index);
+
+		std::shared_ptr<::streamfx::util::threadpool::task> find_work(size_t index);
 	};
 } // namespace streamfx::util
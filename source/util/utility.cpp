@@ -34,6 +34,13 @@
 #pragma warning(pop)
 #endif
 
+#ifdef D_PLATFORM_INSTR_X86
+#include <emmintrin.h>
+#endif
+
+// Rows shorter than this are copied with memcpy, as streaming them bypasses the cache for no gain.
+#define ST_STREAM_MINIMUM_BYTES 256
+
 obs_property_t* streamfx::util::obs_properties_add_tristate(obs_properties_t* props, const char* name, const char* desc)
 {
 	obs_property_t* p = obs_properties_add_list(props, name, desc, OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
@@ -180,3 +187,94 @@ void streamfx::util::free_aligned(void* mem)
 	free(ptr);
 #endif
 }
+
+void streamfx::util::copy_plane(uint8_t* to, std::size_t to_stride, const uint8_t* from, std::size_t from_stride,
+								std::size_t bytes, std::size_t rows)
+{
+	// Planes without padding are a single long row.
+	if ((to_stride == bytes) && (from_stride == bytes)) {
+		bytes *= rows;
+		rows = 1;
+	}
+
+#ifdef D_PLATFORM_INSTR_X86
+	bool streamed = false;
+	for (std::size_t y = 0; y < rows; y++) {
+		uint8_t*       dst = to + to_stride * y;
+		const uint8_t* src = from + from_stride * y;
+		std::size_t    pos = 0;
+
+		if (bytes >= ST_STREAM_MINIMUM_BYTES) {
+			// Non-temporal stores must be aligned, so copy the unaligned head normally.
+			pos = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+			std::memcpy(dst, src, pos);
+
+			for (; (pos + 64) <= bytes; pos += 64) {
+				__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+				__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + 16));
+				__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + 32));
+				__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos + 48));
+				_mm_stream_si128(reinterpret_cast<__m128i*>(dst + pos), r0);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(dst + pos + 16), r1);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(dst + pos + 32), r2);
+				_mm_stream_si128(reinterpret_cast<__m128i*>(dst + pos + 48), r3);
+			}
+			streamed = true;
+		}
+
+		std::memcpy(dst + pos, src + pos, bytes - pos);
+	}
+
+	// Make the streamed data visible to other threads before anyone is told that the copy is done.
+	if (streamed) {
+		_mm_sfence();
+	}
+#else
+	for (std::size_t y = 0; y < rows; y++) {
+		std::memcpy(to + to_stride * y, from + from_stride * y, bytes);
+	}
+#endif
+}
+
+void streamfx::util::shift_row16(uint16_t* to, const uint16_t* from, std::size_t samples, uint8_t shift)
+{
+	std::size_t pos = 0;
+#ifdef D_PLATFORM_INSTR_X86
+	__m128i count = _mm_cvtsi32_si128(shift);
+	for (; (pos + 16) <= samples; pos += 16) {
+		__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + pos));
+		__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + pos + 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + pos), _mm_srl_epi16(r0, count));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + pos + 8), _mm_srl_epi16(r1, count));
+	}
+#endif
+	for (; pos < samples; pos++) {
+		to[pos] = static_cast<uint16_t>(from[pos] >> shift);
+	}
+}
+
+void streamfx::util::deinterleave_row16(uint16_t* to_a, uint16_t* to_b, const uint16_t* from, std::size_t pairs,
+										uint8_t shift)
+{
+	std::size_t pos = 0;
+#ifdef D_PLATFORM_INSTR_X86
+	__m128i count = _mm_cvtsi32_si128(shift);
+	for (; (pos + 8) <= pairs; pos += 8) {
+		__m128i r0 = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(from + pos * 2)), count);
+		__m128i r1 = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(from + pos * 2 + 8)), count);
+
+		// Gather the first sample of each pair in the lower, and the second in the upper half of every register.
+		r0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(r0, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		r1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(r1, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		r0 = _mm_shuffle_epi32(r0, _MM_SHUFFLE(3, 1, 2, 0));
+		r1 = _mm_shuffle_epi32(r1, _MM_SHUFFLE(3, 1, 2, 0));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to_a + pos), _mm_unpacklo_epi64(r0, r1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to_b + pos), _mm_unpackhi_epi64(r0, r1));
+	}
+#endif
+	for (; pos < pairs; pos++) {
+		to_a[pos] = static_cast<uint16_t>(from[pos * 2] >> shift);
+		to_b[pos] = static_cast<uint16_t>(from[pos * 2 + 1] >> shift);
+	}
+}
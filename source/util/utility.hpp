@@ -268,4 +268,17 @@ namespace streamfx::util {
 	}
 	void* malloc_aligned(std::size_t align, std::size_t size);
 	void  free_aligned(void* mem);
+
+	// Copy 'rows' rows of 'bytes' each between two planes with different strides. Large rows are written with
+	// non-temporal stores, so that copying a frame does not evict everything else from the cache.
+	void copy_plane(uint8_t* to, std::size_t to_stride, const uint8_t* from, std::size_t from_stride, std::size_t bytes,
+					std::size_t rows);
+
+	// Shift a row of 16-bit samples right by 'shift' bits, for example to turn the MSB-aligned samples of P010 into
+	// LSB-aligned ones.
+	void shift_row16(uint16_t* to, const uint16_t* from, std::size_t samples, uint8_t shift);
+
+	// Split a row of interleaved 16-bit sample pairs, like the UV plane of P010, into two rows and shift every sample
+	// right by 'shift' bits.
+	void deinterleave_row16(uint16_t* to_a, uint16_t* to_b, const uint16_t* from, std::size_t pairs, uint8_t shift);
 } // namespace streamfx::util
@@ -0,0 +1,194 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include "test.hpp"
+#include <chrono>
+#include <random>
+#include <thread>
+#include "encoders/codecs/av1.hpp"
+
+extern "C" {
+#include <aom/aomcx.h>
+}
+
+// The tile sizes that the encoder uses for real time and good quality encoding.
+#define ST_TILE_SIZE_REALTIME 256
+#define ST_TILE_SIZE_QUALITY 512
+
+using streamfx::encoder::codec::av1::automatic_layout;
+using streamfx::encoder::codec::av1::layout;
+
+P_TEST(aom_av1_layout_single_core)
+{
+	layout chosen = {-1, -1, -1, -1};
+	automatic_layout(chosen, 3840, 2160, ST_TILE_SIZE_REALTIME, 1);
+	P_CHECK(chosen.tile_columns == 0);
+	P_CHECK(chosen.tile_rows == 0);
+	P_CHECK(chosen.rowmultithreading == 0);
+	P_CHECK(chosen.threads == 1);
+}
+
+P_TEST(aom_av1_layout_keeps_explicit_values)
+{
+	layout chosen = {-1, 1, 0, -1};
+	automatic_layout(chosen, 1920, 1080, ST_TILE_SIZE_REALTIME, 16);
+	P_CHECK(chosen.tile_columns == 0);
+	P_CHECK(chosen.tile_rows == 2);
+	P_CHECK(chosen.rowmultithreading == 1);
+	P_CHECK(chosen.threads == 16);
+}
+
+P_TEST(aom_av1_layout_limits)
+{
+	const std::pair<uint32_t, uint32_t> sizes[] = {{640, 360}, {1280, 720}, {1920, 1080}, {3840, 2160}, {7680, 4320}};
+	for (auto& size : sizes) {
+		for (uint32_t tile_size : {ST_TILE_SIZE_REALTIME, ST_TILE_SIZE_QUALITY}) {
+			for (std::size_t cores : {1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 64, 128, 256}) {
+				layout chosen = {-1, -1, -1, -1};
+				automatic_layout(chosen, size.first, size.second, tile_size, cores);
+
+				// Never more tiles than cores, never tiles smaller than asked for unless there is only one.
+				std::size_t tiles = 1ull << (chosen.tile_columns + chosen.tile_rows);
+				P_CHECK(tiles <= cores);
+				P_CHECK((chosen.tile_columns == 0) || ((size.first >> chosen.tile_columns) >= tile_size));
+				P_CHECK((chosen.tile_rows == 0) || ((size.second >> chosen.tile_rows) >= tile_size));
+
+				// Every core is used, either by a tile or with row based multi-threading, up to what libaom supports.
+				P_CHECK(chosen.rowmultithreading == ((cores > tiles) ? 1 : 0));
+				P_CHECK(chosen.threads == static_cast<int8_t>(std::min<std::size_t>(cores, 64)));
+			}
+		}
+	}
+}
+
+/** Encode frames with the given layout, where -1 leaves the value to libaom, and return the frames per second.
+ */
+static double_t encode(uint32_t width, uint32_t height, const layout& layout, const std::vector<aom_image_t*>& frames,
+					   std::size_t& bytes)
+{
+	aom_codec_iface_t*  iface = aom_codec_av1_cx();
+	aom_codec_enc_cfg_t cfg;
+	aom_codec_ctx_t     ctx;
+	if (aom_codec_enc_config_default(iface, &cfg, AOM_USAGE_REALTIME) != AOM_CODEC_OK) {
+		P_CHECK(false);
+		return 0;
+	}
+
+	// The defaults of the encoder: real time usage at 6000 kbit/s constant bitrate.
+	cfg.g_w               = width;
+	cfg.g_h               = height;
+	cfg.g_timebase        = {1, 60};
+	cfg.g_threads         = static_cast<unsigned int>(layout.threads);
+	cfg.rc_end_usage      = AOM_CBR;
+	cfg.rc_target_bitrate = 6000;
+	if (aom_codec_enc_init(&ctx, iface, &cfg, 0) != AOM_CODEC_OK) {
+		P_CHECK(false);
+		return 0;
+	}
+	if (layout.rowmultithreading != -1) {
+		P_CHECK(aom_codec_control(&ctx, AV1E_SET_ROW_MT, static_cast<unsigned int>(layout.rowmultithreading))
+				== AOM_CODEC_OK);
+	}
+	if (layout.tile_columns != -1) {
+		P_CHECK(aom_codec_control(&ctx, AV1E_SET_TILE_COLUMNS, static_cast<int>(layout.tile_columns)) == AOM_CODEC_OK);
+	}
+	if (layout.tile_rows != -1) {
+		P_CHECK(aom_codec_control(&ctx, AV1E_SET_TILE_ROWS, static_cast<int>(layout.tile_rows)) == AOM_CODEC_OK);
+	}
+
+	bytes      = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t idx = 0; idx <= frames.size(); idx++) {
+		// Flush the encoder after the last frame.
+		aom_image_t* frame = (idx < frames.size()) ? frames[idx] : nullptr;
+		P_CHECK(aom_codec_encode(&ctx, frame, static_cast<aom_codec_pts_t>(idx), 1, 0) == AOM_CODEC_OK);
+
+		aom_codec_iter_t iter = nullptr;
+		while (const aom_codec_cx_pkt_t* pkt = aom_codec_get_cx_data(&ctx, &iter)) {
+			if (pkt->kind == AOM_CODEC_CX_FRAME_PKT) {
+				bytes += pkt->data.frame.sz;
+			}
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	aom_codec_destroy(&ctx);
+
+	return static_cast<double_t>(frames.size()) / std::chrono::duration<double_t>(end - start).count();
+}
+
+P_BENCHMARK(aom_av1_layout)
+{
+	// The encoder used every core, and left row based multi-threading and tiles to libaom.
+	std::size_t cores = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	layout      old   = {static_cast<int8_t>(std::min<std::size_t>(cores, 64)), -1, -1, -1};
+
+	const std::pair<uint32_t, uint32_t> sizes[] = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+	printf("%-10s %-22s %-22s %10s %10s %8s %8s\n", "Size", "Default", "Automatic", "Default", "Automatic", "Speedup",
+		   "Size");
+	for (auto& size : sizes) {
+		// Noise that moves across the frame, which keeps motion search and entropy coding busy.
+		std::mt19937              engine(0x5F3759DF);
+		std::vector<uint8_t>      noise(static_cast<std::size_t>(size.first) * size.second * 2);
+		std::vector<aom_image_t*> frames(120);
+		for (auto& sample : noise) {
+			sample = static_cast<uint8_t>(engine() & 0x3F);
+		}
+		for (std::size_t idx = 0; idx < frames.size(); idx++) {
+			aom_image_t* frame = aom_img_alloc(nullptr, AOM_IMG_FMT_I420, size.first, size.second, 32);
+			for (int plane = AOM_PLANE_Y; plane <= AOM_PLANE_V; plane++) {
+				std::size_t rows    = (plane == AOM_PLANE_Y) ? size.second : (size.second + 1) / 2;
+				std::size_t columns = (plane == AOM_PLANE_Y) ? size.first : (size.first + 1) / 2;
+				for (std::size_t row = 0; row < rows; row++) {
+					uint8_t* ptr = frame->planes[plane] + static_cast<ptrdiff_t>(frame->stride[plane]) * row;
+					for (std::size_t column = 0; column < columns; column++) {
+						std::size_t gradient = (column + row) / 4 + idx * 2;
+						std::size_t offset   = (row * columns + column + idx * 8) % noise.size();
+						ptr[column]          = static_cast<uint8_t>(gradient + noise[offset]);
+					}
+				}
+			}
+			frames[idx] = frame;
+		}
+
+		layout chosen = {-1, -1, -1, -1};
+		automatic_layout(chosen, size.first, size.second, ST_TILE_SIZE_REALTIME, cores);
+
+		std::size_t old_bytes    = 0;
+		std::size_t chosen_bytes = 0;
+		double_t    old_fps      = encode(size.first, size.second, old, frames, old_bytes);
+		double_t    chosen_fps   = encode(size.first, size.second, chosen, frames, chosen_bytes);
+		for (auto frame : frames) {
+			aom_img_free(frame);
+		}
+
+		char resolution[16];
+		char old_layout[32];
+		char chosen_layout[32];
+		snprintf(resolution, sizeof(resolution), "%" PRIu32 "x%" PRIu32, size.first, size.second);
+		snprintf(old_layout, sizeof(old_layout), "%" PRId8 " threads", old.threads);
+		snprintf(chosen_layout, sizeof(chosen_layout), "%" PRId8 " threads, %dx%d, %s", chosen.threads,
+				 1 << chosen.tile_columns, 1 << chosen.tile_rows, chosen.rowmultithreading ? "row" : "tile");
+		printf("%-10s %-22s %-22s %6.1f fps %6.1f fps %7.2fx %7.1f%%\n", resolution, old_layout, chosen_layout, old_fps,
+			   chosen_fps, chosen_fps / old_fps,
+			   100. * static_cast<double_t>(chosen_bytes) / static_cast<double_t>(std::max<std::size_t>(old_bytes, 1)));
+
+		// Timing is noisy, but the chosen layout must not be clearly slower than what it replaced.
+		P_CHECK(chosen_fps >= old_fps * 0.9);
+	}
+}
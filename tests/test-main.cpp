@@ -0,0 +1,86 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include "test.hpp"
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+static std::atomic_bool failed{false};
+
+std::vector<streamfx::test::test_case>& streamfx::test::registry()
+{
+	static std::vector<streamfx::test::test_case> tests;
+	return tests;
+}
+
+void streamfx::test::fail(const char* file, int line, const char* expression)
+{
+	failed.store(true);
+	fprintf(stderr, "%s:%d: Check failed: %s\n", file, line, expression);
+}
+
+bool streamfx::test::wait_for(std::function<bool()> condition, std::chrono::milliseconds timeout)
+{
+	auto until = std::chrono::steady_clock::now() + timeout;
+	while (!condition()) {
+		if (std::chrono::steady_clock::now() >= until) {
+			return condition();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+int main(int argc, const char* argv[])
+{
+	// Run every test, or with --benchmark every benchmark, optionally only those whose name contains a filter.
+	bool        benchmark = false;
+	const char* filter    = nullptr;
+	for (int idx = 1; idx < argc; idx++) {
+		if (strcmp(argv[idx], "--benchmark") == 0) {
+			benchmark = true;
+		} else {
+			filter = argv[idx];
+		}
+	}
+
+	std::size_t failures = 0;
+	std::size_t ran      = 0;
+	for (auto& test : streamfx::test::registry()) {
+		if ((test.benchmark != benchmark) || (filter && (strstr(test.name, filter) == nullptr))) {
+			continue;
+		}
+
+		ran++;
+		failed.store(false);
+		auto start = std::chrono::steady_clock::now();
+		test.function();
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+		bool passed = !failed.load();
+		printf("%-4s %s (%lld ms)\n", passed ? "OK" : "FAIL", test.name, static_cast<long long>(duration.count()));
+		if (!passed) {
+			failures++;
+		}
+	}
+
+	printf("%zu of %zu %s failed.\n", failures, ran, benchmark ? "benchmarks" : "tests");
+	return (failures > 0) ? 1 : 0;
+}
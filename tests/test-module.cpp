@@ -0,0 +1,33 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include "plugin.hpp"
+
+// Stand-ins for what the module itself provides to the code under test.
+
+const char* obs_module_text(const char* lookup)
+{
+	return lookup;
+}
+
+std::shared_ptr<streamfx::util::threadpool> streamfx::threadpool()
+{
+	static auto pool = std::make_shared<streamfx::util::threadpool>();
+	return pool;
+}
@@ -0,0 +1,202 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include "test.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include "util/util-profiler.hpp"
+
+// Nearest rank percentile of a sorted list of samples, which is what the histogram approximates.
+static uint64_t exact_percentile(const std::vector<uint64_t>& sorted, double_t percentile)
+{
+	double_t    rank  = std::ceil(double_t(sorted.size()) * percentile);
+	std::size_t index = static_cast<std::size_t>(std::max(rank, 1.0)) - 1;
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// The histogram reports the lower edge of a bucket, and every bucket covers 1/32 of its power of two.
+static bool is_close(uint64_t actual, uint64_t expected)
+{
+	return (actual <= expected) && (actual >= (expected - (expected >> streamfx::util::profiler::sub_bucket_bits)));
+}
+
+P_TEST(profiler_empty)
+{
+	auto profiler = streamfx::util::profiler::create();
+	P_CHECK(profiler->count() == 0);
+	P_CHECK(profiler->percentile(0.5).count() == -1);
+	P_CHECK(profiler->percentile(0.5, true).count() == -1);
+}
+
+P_TEST(profiler_small_values_are_exact)
+{
+	auto profiler = streamfx::util::profiler::create();
+	for (int64_t value = 0; value < 32; value++) {
+		profiler->track(std::chrono::nanoseconds(value));
+	}
+
+	P_CHECK(profiler->count() == 32);
+	P_CHECK(profiler->total_duration().count() == (31 * 32 / 2));
+	P_CHECK(profiler->percentile(0.0).count() == 0);
+	P_CHECK(profiler->percentile(0.5).count() == 15);
+	P_CHECK(profiler->percentile(1.0).count() == 31);
+}
+
+P_TEST(profiler_percentiles)
+{
+	// Spread samples logarithmically from nanoseconds to seconds, so that every magnitude gets some.
+	std::mt19937                           engine(0x5F3759DF);
+	std::uniform_real_distribution<double> distribution(0.0, 30.0);
+	std::vector<uint64_t>                  samples(100000);
+	for (auto& sample : samples) {
+		sample = static_cast<uint64_t>(std::exp2(distribution(engine)));
+	}
+
+	auto profiler = streamfx::util::profiler::create();
+	for (auto sample : samples) {
+		profiler->track(std::chrono::nanoseconds(sample));
+	}
+	std::sort(samples.begin(), samples.end());
+
+	P_CHECK(profiler->count() == samples.size());
+	for (double_t percentile : {0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999, 0.9999, 1.0}) {
+		uint64_t expected = exact_percentile(samples, percentile);
+		uint64_t actual   = static_cast<uint64_t>(profiler->percentile(percentile).count());
+		if (!is_close(actual, expected)) {
+			fprintf(stderr, "%8.4f%%ile: expected %" PRIu64 ", got %" PRIu64 "\n", percentile * 100., expected, actual);
+		}
+		P_CHECK(is_close(actual, expected));
+	}
+}
+
+P_TEST(profiler_percentiles_by_time)
+{
+	auto profiler = streamfx::util::profiler::create();
+	for (int64_t value = 1000; value <= 2000; value++) {
+		profiler->track(std::chrono::nanoseconds(value));
+	}
+
+	// Halfway between the shortest and the longest duration.
+	P_CHECK(is_close(static_cast<uint64_t>(profiler->percentile(0.5, true).count()), 1500));
+	P_CHECK(profiler->percentile(0.0, true).count() == 1000);
+	P_CHECK(profiler->percentile(1.0, true).count() <= 2000);
+}
+
+P_TEST(profiler_huge_values)
+{
+	// Everything beyond the largest magnitude ends up in the last bucket, but the maximum is still exact.
+	auto profiler = streamfx::util::profiler::create();
+	profiler->track(std::chrono::nanoseconds(std::numeric_limits<int64_t>::max()));
+	profiler->track(std::chrono::nanoseconds(-5));
+
+	P_CHECK(profiler->count() == 2);
+	P_CHECK(profiler->percentile(0.5).count() == 0);
+	P_CHECK(profiler->percentile(1.0).count() > 0);
+}
+
+P_TEST(profiler_concurrent)
+{
+	constexpr std::size_t threads = 4;
+	constexpr std::size_t samples = 100000;
+
+	auto                     profiler = streamfx::util::profiler::create();
+	std::vector<std::thread> workers;
+	for (std::size_t thread = 0; thread < threads; thread++) {
+		workers.emplace_back([profiler, thread]() {
+			for (std::size_t idx = 0; idx < samples; idx++) {
+				profiler->track(std::chrono::nanoseconds(1000 * (thread + 1)));
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	P_CHECK(profiler->count() == (threads * samples));
+	P_CHECK(profiler->total_duration().count() == (1000 * samples * (threads * (threads + 1) / 2)));
+	P_CHECK(profiler->percentile(0.0).count() == 1000);
+	P_CHECK(is_close(static_cast<uint64_t>(profiler->percentile(0.5).count()), 2000));
+	P_CHECK(is_close(static_cast<uint64_t>(profiler->percentile(1.0).count()), 4000));
+}
+
+P_TEST(profiler_registry)
+{
+	auto first  = streamfx::util::profiler::create("Test");
+	auto second = streamfx::util::profiler::create("Test");
+	P_CHECK(first == second);
+	P_CHECK(first->name() == "Test");
+
+	// Once nobody holds on to it anymore, the same name gives a fresh profiler.
+	first->track(std::chrono::nanoseconds(100));
+	first.reset();
+	second.reset();
+	auto third = streamfx::util::profiler::create("Test");
+	P_CHECK(third->count() == 0);
+}
+
+P_TEST(profiler_enabled)
+{
+	auto profiler = streamfx::util::profiler::create();
+
+	streamfx::util::profiler::set_enabled(false);
+	P_CHECK(!streamfx::util::profiler::is_enabled());
+	P_CHECK(profiler->track() == nullptr);
+
+	streamfx::util::profiler::set_enabled(true);
+	P_CHECK(streamfx::util::profiler::is_enabled());
+	profiler->track().reset();
+	P_CHECK(profiler->count() == 1);
+
+	// A trace enables profiling until it stops, as it would be empty otherwise.
+	streamfx::util::profiler::set_enabled(false);
+	streamfx::util::profiler::start_trace();
+	P_CHECK(streamfx::util::profiler::is_enabled());
+	streamfx::util::profiler::stop_trace();
+	P_CHECK(!streamfx::util::profiler::is_enabled());
+}
+
+P_TEST(profiler_trace)
+{
+	auto file = std::filesystem::temp_directory_path() / "streamfx-test-trace.json";
+	auto now  = std::chrono::steady_clock::now();
+
+	// Events outside of a trace are not kept.
+	streamfx::util::profiler::trace("Outside", now, now + std::chrono::microseconds(1));
+
+	streamfx::util::profiler::start_trace();
+	streamfx::util::profiler::trace("Inside", now, now + std::chrono::microseconds(1));
+	std::thread([now]() {
+		streamfx::util::profiler::trace("Thread \"Quoted\"", now, now + std::chrono::microseconds(2));
+	}).join();
+	streamfx::util::profiler::stop_trace();
+	streamfx::util::profiler::export_trace(file);
+
+	std::stringstream content;
+	content << std::ifstream(file).rdbuf();
+	std::filesystem::remove(file);
+
+	P_CHECK(content.str().find("\"Inside\"") != std::string::npos);
+	P_CHECK(content.str().find("\"Thread \\\"Quoted\\\"\"") != std::string::npos);
+	P_CHECK(content.str().find("\"Outside\"") == std::string::npos);
+}
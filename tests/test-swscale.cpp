@@ -0,0 +1,257 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include "test.hpp"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include "ffmpeg/swscale.hpp"
+#include "plugin.hpp"
+
+extern "C" {
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4242 4244 4365)
+#endif
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+}
+
+/** An image in system memory, with padded rows like the frames that libOBS and FFmpeg hand out.
+ */
+class image {
+	public:
+	std::vector<uint8_t> planes[4];
+	uint8_t*             data[4];
+	int                  stride[4];
+	int                  bytes[4]; // Bytes per row that belong to the image, the rest is padding.
+	int32_t              rows[4];
+
+	image(AVPixelFormat format, int32_t width, int32_t height) : planes(), data(), stride(), bytes(), rows()
+	{
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+		av_image_fill_linesizes(bytes, format, width);
+		for (int plane = 0; plane < av_pix_fmt_count_planes(format); plane++) {
+			rows[plane] = height;
+			if ((plane == 1) || (plane == 2)) {
+				rows[plane] = (height + (1 << desc->log2_chroma_h) - 1) >> desc->log2_chroma_h;
+			}
+
+			stride[plane] = (bytes[plane] + 63) & ~63;
+			planes[plane].resize(static_cast<std::size_t>(stride[plane]) * static_cast<std::size_t>(rows[plane]));
+			data[plane] = planes[plane].data();
+		}
+	}
+
+	/** Compare the pixels of two images of the same format and size, but not whatever swscale left in the padding.
+	 */
+	bool operator==(const image& other) const
+	{
+		for (std::size_t plane = 0; plane < 4; plane++) {
+			for (int32_t row = 0; row < rows[plane]; row++) {
+				if (memcmp(data[plane] + static_cast<ptrdiff_t>(stride[plane]) * row,
+						   other.data[plane] + static_cast<ptrdiff_t>(other.stride[plane]) * row, bytes[plane])
+					!= 0) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void randomize(std::mt19937& engine)
+	{
+		std::uniform_int_distribution<uint32_t> distribution(0, 0xFF);
+		for (auto& plane : planes) {
+			for (auto& value : plane) {
+				value = static_cast<uint8_t>(distribution(engine));
+			}
+		}
+	}
+};
+
+static bool initialize(streamfx::ffmpeg::swscale& scaler, AVPixelFormat source_format, AVPixelFormat target_format,
+					   int32_t source_width, int32_t target_width, int32_t height, std::size_t threads)
+{
+	bool source_rgb = (av_pix_fmt_desc_get(source_format)->flags & AV_PIX_FMT_FLAG_RGB) != 0;
+	bool target_rgb = (av_pix_fmt_desc_get(target_format)->flags & AV_PIX_FMT_FLAG_RGB) != 0;
+
+	scaler.set_source_size(static_cast<uint32_t>(source_width), static_cast<uint32_t>(height));
+	scaler.set_source_format(source_format);
+	scaler.set_source_color(source_rgb, AVCOL_SPC_BT709);
+	scaler.set_target_size(static_cast<uint32_t>(target_width), static_cast<uint32_t>(height));
+	scaler.set_target_format(target_format);
+	scaler.set_target_color(target_rgb, AVCOL_SPC_BT709);
+	return scaler.initialize(SWS_POINT, threads);
+}
+
+static int32_t convert(streamfx::ffmpeg::swscale& scaler, const image& source, image& target)
+{
+	return scaler.convert(source.data, source.stride, 0, static_cast<int32_t>(scaler.get_source_height()),
+						  target.data, target.stride);
+}
+
+struct conversion {
+	AVPixelFormat source;
+	AVPixelFormat target;
+};
+
+// Conversions that the encoders run between what libOBS provides and what they need, plus a few that stress chroma
+// subsampling, dithering and 10-bit formats. Those that resample chroma vertically must never be split into bands.
+static const conversion conversions[] = {
+	{AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P},        {AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12},
+	{AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV420P},     {AV_PIX_FMT_YUV444P, AV_PIX_FMT_NV12},
+	{AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV444P},     {AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV420P},
+	{AV_PIX_FMT_YUYV422, AV_PIX_FMT_YUV420P},     {AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P},
+	{AV_PIX_FMT_RGBA, AV_PIX_FMT_NV12},           {AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV444P},
+	{AV_PIX_FMT_YUV420P, AV_PIX_FMT_BGRA},        {AV_PIX_FMT_P010LE, AV_PIX_FMT_YUV420P10LE},
+	{AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P}, {AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_P010LE},
+};
+
+P_TEST(swscale_bands_match_single_context)
+{
+	std::mt19937 engine(0x5F3759DF);
+
+	// Heights around the 64 row minimum and the 8 row band alignment, odd heights that leave a half chroma row, and
+	// full frames. Widths include odd ones, and one that is scaled horizontally, which still allows bands.
+	// Padding is ignored, as swscale may leave different values there.
+	const int32_t                     heights[] = {1, 2, 7, 63, 64, 65, 71, 127, 128, 129, 200, 719, 1080};
+	const std::pair<int32_t, int32_t> widths[]  = {{17, 17}, {640, 640}, {1920, 1280}};
+	const std::size_t                 threads[] = {2, 3, 4, 16};
+	std::size_t                       checked   = 0;
+
+	for (auto& entry : conversions) {
+		bool splits =
+			(av_pix_fmt_desc_get(entry.source)->log2_chroma_h == av_pix_fmt_desc_get(entry.target)->log2_chroma_h);
+		for (auto height : heights) {
+			for (auto& width : widths) {
+				image source(entry.source, width.first, height);
+				source.randomize(engine);
+
+				image                     expected(entry.target, width.second, height);
+				streamfx::ffmpeg::swscale single;
+				P_CHECK(initialize(single, entry.source, entry.target, width.first, width.second, height, 1));
+				P_CHECK(single.get_slices() == 1);
+				P_CHECK(convert(single, source, expected) == height);
+
+				for (auto count : threads) {
+					image                     actual(entry.target, width.second, height);
+					streamfx::ffmpeg::swscale banded;
+					P_CHECK(initialize(banded, entry.source, entry.target, width.first, width.second, height, count));
+					P_CHECK(convert(banded, source, actual) == height);
+
+					// Bands are never smaller than 64 rows, except for the last one.
+					std::size_t slices = banded.get_slices();
+					P_CHECK((splits && (height > 64)) ? (slices > 1) : (slices == 1));
+
+					bool matches = (actual == expected);
+					if (!matches) {
+						fprintf(stderr, "%s to %s at %" PRId32 "x%" PRId32 " (to %" PRId32 ") in %zu bands differs.\n",
+								av_get_pix_fmt_name(entry.source), av_get_pix_fmt_name(entry.target), width.first,
+								height, width.second, slices);
+					}
+					P_CHECK(matches);
+					checked++;
+				}
+			}
+		}
+	}
+	P_CHECK(checked > 0);
+}
+
+P_TEST(swscale_partial_conversion)
+{
+	// Converting only some rows of the image still goes through the single context.
+	std::mt19937 engine(0x5F3759DF);
+	image        source(AV_PIX_FMT_NV12, 640, 360);
+	image        expected(AV_PIX_FMT_YUV420P, 640, 360);
+	image        actual(AV_PIX_FMT_YUV420P, 640, 360);
+	source.randomize(engine);
+
+	streamfx::ffmpeg::swscale scaler;
+	P_CHECK(initialize(scaler, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P, 640, 640, 360, 4));
+	P_CHECK(scaler.get_slices() > 1);
+	P_CHECK(convert(scaler, source, expected) == 360);
+
+	// Slices have to be handed to swscale in order, from top to bottom, and start at the first row of the slice.
+	const uint8_t* lower[4] = {source.data[0] + source.stride[0] * 120, source.data[1] + source.stride[1] * 60};
+	P_CHECK(scaler.convert(source.data, source.stride, 0, 120, actual.data, actual.stride) > 0);
+	P_CHECK(scaler.convert(lower, source.stride, 120, 240, actual.data, actual.stride) > 0);
+	P_CHECK(actual == expected);
+}
+
+P_BENCHMARK(swscale)
+{
+	// The same number of bands that the conversion stage uses.
+	std::size_t bands = streamfx::threadpool()->layout().workers + 1;
+	bands             = std::min<std::size_t>(bands, std::max<unsigned int>(std::thread::hardware_concurrency(), 1));
+
+	const std::pair<int32_t, int32_t> sizes[]       = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+	const conversion                  benchmarked[] = {
+		// Only conversions that can be split into bands, the others run the same code either way.
+		{AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P},
+		{AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12},
+		{AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV444P},
+		{AV_PIX_FMT_P010LE, AV_PIX_FMT_YUV420P10LE},
+	};
+
+	printf("%-28s %-10s %8s %12s %12s %8s\n", "Conversion", "Size", "Bands", "Single", "Banded", "Speedup");
+	std::mt19937 engine(0x5F3759DF);
+	for (auto& size : sizes) {
+		for (auto& entry : benchmarked) {
+			image source(entry.source, size.first, size.second);
+			image target(entry.target, size.first, size.second);
+			source.randomize(engine);
+
+			// Median of many runs, after a few runs to warm up caches and workers.
+			std::size_t slices  = 0;
+			auto        measure = [&](std::size_t threads) {
+				streamfx::ffmpeg::swscale scaler;
+				P_CHECK(initialize(scaler, entry.source, entry.target, size.first, size.first, size.second, threads));
+				slices = scaler.get_slices();
+
+				std::vector<double_t> times;
+				for (std::size_t run = 0; run < 53; run++) {
+					auto start = std::chrono::steady_clock::now();
+					P_CHECK(convert(scaler, source, target) == size.second);
+					auto end = std::chrono::steady_clock::now();
+					if (run >= 3) {
+						times.push_back(std::chrono::duration<double_t, std::milli>(end - start).count());
+					}
+				}
+				std::sort(times.begin(), times.end());
+				return times[times.size() / 2];
+			};
+
+			double_t single = measure(1);
+			double_t banded = measure(bands);
+
+			char conversion[64];
+			char resolution[16];
+			snprintf(conversion, sizeof(conversion), "%s > %s", av_get_pix_fmt_name(entry.source),
+					 av_get_pix_fmt_name(entry.target));
+			snprintf(resolution, sizeof(resolution), "%" PRId32 "x%" PRId32, size.first, size.second);
+			printf("%-28s %-10s %8zu %9.3f ms %9.3f ms %7.2fx\n", conversion, resolution, slices, single, banded,
+				   single / banded);
+		}
+	}
+}
@@ -0,0 +1,515 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include "test.hpp"
+#include <future>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include "util/util-threadpool.hpp"
+
+using streamfx::util::threadpool;
+using streamfx::util::threadpool_data_t;
+using streamfx::util::threadpool_priority;
+using streamfx::util::threadpool_settings;
+
+static std::shared_ptr<threadpool> create_pool(std::size_t workers, std::size_t background_workers = 0)
+{
+	threadpool_settings settings;
+	settings.workers            = workers;
+	settings.background_workers = background_workers;
+	return std::make_shared<threadpool>(settings);
+}
+
+/** Keeps a worker busy until it is released, so that tests can queue up work in a known state.
+ */
+class blocker {
+	std::promise<void>       _release;
+	std::shared_future<void> _released;
+	std::promise<void>       _started;
+
+	public:
+	blocker() : _release(), _released(_release.get_future().share()), _started() {}
+
+	void block(threadpool& pool, threadpool_priority priority = threadpool_priority::REALTIME)
+	{
+		pool.push(
+			[this](threadpool_data_t) {
+				_started.set_value();
+				_released.wait();
+			},
+			nullptr, priority);
+		_started.get_future().wait();
+	}
+
+	void release()
+	{
+		_release.set_value();
+	}
+};
+
+/** Records the order in which tasks ran.
+ */
+class recorder {
+	std::mutex       _lock;
+	std::vector<int> _order;
+
+	public:
+	void record(int value)
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		_order.push_back(value);
+	}
+
+	std::vector<int> order()
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		return _order;
+	}
+};
+
+P_TEST(threadpool_runs_tasks)
+{
+	static constexpr std::size_t tasks = 10000;
+
+	auto            pool = create_pool(4);
+	std::atomic_int counter{0};
+
+	for (std::size_t idx = 0; idx < tasks; idx++) {
+		pool->push([&counter](threadpool_data_t) { counter.fetch_add(1); }, nullptr);
+	}
+	P_CHECK(streamfx::test::wait_for([&counter]() { return counter.load() == tasks; }));
+}
+
+P_TEST(threadpool_passes_data)
+{
+	auto              pool = create_pool(1);
+	std::promise<int> result;
+	std::future<int>  future = result.get_future();
+	threadpool_data_t data   = std::make_shared<int>(42);
+	pool->push([&result](threadpool_data_t data) { result.set_value(*std::static_pointer_cast<int>(data)); }, data);
+	P_CHECK(future.get() == 42);
+}
+
+P_TEST(threadpool_priority_order)
+{
+	auto     pool = create_pool(1);
+	blocker  gate;
+	recorder tasks;
+
+	// With the only worker busy, queue the lanes in the reverse order of how they should run.
+	gate.block(*pool);
+	pool->push([&tasks](threadpool_data_t) { tasks.record(5); }, nullptr, threadpool_priority::BACKGROUND);
+	pool->push([&tasks](threadpool_data_t) { tasks.record(6); }, nullptr, threadpool_priority::BACKGROUND);
+	pool->push([&tasks](threadpool_data_t) { tasks.record(3); }, nullptr, threadpool_priority::NORMAL);
+	pool->push([&tasks](threadpool_data_t) { tasks.record(4); }, nullptr, threadpool_priority::NORMAL);
+	pool->push([&tasks](threadpool_data_t) { tasks.record(1); }, nullptr, threadpool_priority::REALTIME);
+	pool->push([&tasks](threadpool_data_t) { tasks.record(2); }, nullptr, threadpool_priority::REALTIME);
+	gate.release();
+
+	P_CHECK(streamfx::test::wait_for([&tasks]() { return tasks.order().size() == 6; }));
+	P_CHECK(tasks.order() == std::vector<int>({1, 2, 3, 4, 5, 6}));
+}
+
+P_TEST(threadpool_background_limit)
+{
+	// Background tasks may only ever occupy half of the workers, the rest stays free for everything else.
+	auto            pool = create_pool(4);
+	std::atomic_int active{0};
+	std::atomic_int peak{0};
+	std::atomic_int done{0};
+
+	for (std::size_t idx = 0; idx < 16; idx++) {
+		pool->push(
+			[&](threadpool_data_t) {
+				int now = active.fetch_add(1) + 1;
+				for (int last = peak.load(); (now > last) && !peak.compare_exchange_weak(last, now);) {
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				active.fetch_sub(1);
+				done.fetch_add(1);
+			},
+			nullptr, threadpool_priority::BACKGROUND);
+	}
+
+	// Meanwhile, normal tasks still get through.
+	std::promise<void> normal;
+	pool->push([&normal](threadpool_data_t) { normal.set_value(); }, nullptr);
+	P_CHECK(normal.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+
+	P_CHECK(streamfx::test::wait_for([&done]() { return done.load() == 16; }));
+	P_CHECK(peak.load() <= 2);
+}
+
+P_TEST(threadpool_background_workers)
+{
+	// Dedicated background workers run all background tasks, regular workers never do.
+	auto                      pool = create_pool(2, 1);
+	std::mutex                lock;
+	std::set<std::thread::id> regular;
+	std::set<std::thread::id> background;
+	std::atomic_int           done{0};
+
+	for (std::size_t idx = 0; idx < 100; idx++) {
+		pool->push(
+			[&](threadpool_data_t) {
+				{
+					std::unique_lock<std::mutex> ul(lock);
+					regular.insert(std::this_thread::get_id());
+				}
+				done.fetch_add(1);
+			},
+			nullptr);
+		pool->push(
+			[&](threadpool_data_t) {
+				{
+					std::unique_lock<std::mutex> ul(lock);
+					background.insert(std::this_thread::get_id());
+				}
+				done.fetch_add(1);
+			},
+			nullptr, threadpool_priority::BACKGROUND);
+	}
+	P_CHECK(streamfx::test::wait_for([&done]() { return done.load() == 200; }));
+
+	std::unique_lock<std::mutex> ul(lock);
+	P_CHECK(background.size() == 1);
+	for (auto& id : background) {
+		P_CHECK(regular.count(id) == 0);
+	}
+}
+
+P_TEST(threadpool_deadline)
+{
+	auto             pool = create_pool(1);
+	blocker          gate;
+	std::atomic_bool late{false};
+	std::atomic_bool early{false};
+
+	gate.block(*pool);
+	auto group = pool->create_group();
+	group->push([&late](threadpool_data_t) { late = true; }, nullptr, threadpool_priority::NORMAL,
+				std::chrono::steady_clock::now() + std::chrono::milliseconds(1));
+	group->push([&early](threadpool_data_t) { early = true; }, nullptr, threadpool_priority::NORMAL,
+				std::chrono::steady_clock::now() + std::chrono::seconds(60));
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	gate.release();
+
+	// Dropped tasks still count as finished for their group.
+	P_CHECK(group->wait_until(std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+	P_CHECK(!late.load());
+	P_CHECK(early.load());
+}
+
+P_TEST(threadpool_pop)
+{
+	auto             pool = create_pool(1);
+	blocker          gate;
+	std::atomic_bool killed{false};
+	std::atomic_bool alive{false};
+
+	gate.block(*pool);
+	auto group = pool->create_group();
+	pool->pop(group->push([&killed](threadpool_data_t) { killed = true; }, nullptr));
+	group->push([&alive](threadpool_data_t) { alive = true; }, nullptr);
+	gate.release();
+
+	P_CHECK(group->wait_until(std::chrono::steady_clock::now() + std::chrono::seconds(10)));
+	P_CHECK(!killed.load());
+	P_CHECK(alive.load());
+}
+
+P_TEST(threadpool_stealing)
+{
+	// Work queued by a worker lands on its own queue. While that worker is busy, the others have to steal it.
+	static constexpr std::size_t tasks = 64;
+
+	auto                      pool = create_pool(4);
+	std::mutex                lock;
+	std::set<std::thread::id> thieves;
+	std::atomic_size_t        done{0};
+	std::promise<bool>        result;
+
+	pool->push(
+		[&](threadpool_data_t) {
+			auto owner = std::this_thread::get_id();
+			for (std::size_t idx = 0; idx < tasks; idx++) {
+				pool->push(
+					[&, owner](threadpool_data_t) {
+						if (std::this_thread::get_id() != owner) {
+							std::unique_lock<std::mutex> ul(lock);
+							thieves.insert(std::this_thread::get_id());
+						}
+						std::this_thread::sleep_for(std::chrono::microseconds(100));
+						done.fetch_add(1);
+					},
+					nullptr);
+			}
+
+			// Hold on to this worker until every task ran elsewhere.
+			result.set_value(streamfx::test::wait_for([&done]() { return done.load() == tasks; }));
+		},
+		nullptr);
+
+	P_CHECK(result.get_future().get());
+	std::unique_lock<std::mutex> ul(lock);
+	P_CHECK(!thieves.empty());
+}
+
+P_TEST(threadpool_task_group)
+{
+	auto                      pool  = create_pool(4);
+	auto                      group = pool->create_group();
+	std::atomic_size_t        counter{0};
+	std::promise<std::size_t> continued;
+
+	P_CHECK(group->empty());
+	for (std::size_t idx = 0; idx < 1000; idx++) {
+		group->push(
+			[&counter](threadpool_data_t) {
+				std::this_thread::sleep_for(std::chrono::microseconds(10));
+				counter.fetch_add(1);
+			},
+			nullptr);
+	}
+	group->then([&](threadpool_data_t) { continued.set_value(counter.load()); }, nullptr);
+	group->wait();
+
+	P_CHECK(group->empty());
+	P_CHECK(counter.load() == 1000);
+	P_CHECK(continued.get_future().get() == 1000);
+
+	// Continuing an empty group runs right away.
+	std::promise<void> immediate;
+	group->then([&immediate](threadpool_data_t) { immediate.set_value(); }, nullptr);
+	P_CHECK(immediate.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+}
+
+P_TEST(threadpool_async)
+{
+	auto pool = create_pool(2);
+
+	auto value = pool->async([]() { return 6 * 7; });
+	P_CHECK(value.get() == 42);
+
+	auto error = pool->async([]() -> int { throw std::runtime_error("expected"); });
+	bool threw = false;
+	try {
+		error.get();
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	P_CHECK(threw);
+
+	auto nothing = pool->async([]() {}, threadpool_priority::BACKGROUND);
+	P_CHECK(nothing.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+}
+
+P_TEST(threadpool_parallel_for)
+{
+	auto pool = create_pool(4);
+
+	// Every index is visited exactly once, no matter how the range divides into chunks.
+	for (std::size_t grain : {1, 3, 7, 64, 1000, 5000}) {
+		std::vector<std::atomic_int> hits(1000);
+		pool->parallel_for(17, 1017, grain, [&hits](std::size_t begin, std::size_t end) {
+			P_CHECK(begin < end);
+			for (std::size_t idx = begin; idx < end; idx++) {
+				hits[idx - 17].fetch_add(1);
+			}
+		});
+
+		bool once = true;
+		for (auto& hit : hits) {
+			once &= (hit.load() == 1);
+		}
+		P_CHECK(once);
+	}
+
+	// Empty ranges do nothing, and a grain of 0 is treated as 1.
+	std::atomic_int calls{0};
+	pool->parallel_for(5, 5, 1, [&calls](std::size_t, std::size_t) { calls.fetch_add(1); });
+	P_CHECK(calls.load() == 0);
+	pool->parallel_for(0, 4, 0, [&calls](std::size_t begin, std::size_t end) { calls.fetch_add(int(end - begin)); });
+	P_CHECK(calls.load() == 4);
+}
+
+P_TEST(threadpool_parallel_for_exception)
+{
+	auto            pool = create_pool(4);
+	std::atomic_int chunks{0};
+	bool            threw = false;
+
+	try {
+		pool->parallel_for(0, 1000, 1, [&chunks](std::size_t begin, std::size_t) {
+			chunks.fetch_add(1);
+			if (begin == 10) {
+				throw std::runtime_error("expected");
+			}
+		});
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+
+	P_CHECK(threw);
+	P_CHECK(chunks.load() <= 1000);
+}
+
+P_TEST(threadpool_parallel_for_nested)
+{
+	// The caller works on chunks too, so this finishes even if it is the only worker and blocked inside a task.
+	auto              pool = create_pool(1);
+	std::promise<int> result;
+	pool->push(
+		[&](threadpool_data_t) {
+			std::atomic_int sum{0};
+			pool->parallel_for(0, 100, 10, [&sum](std::size_t begin, std::size_t end) {
+				for (std::size_t idx = begin; idx < end; idx++) {
+					sum.fetch_add(int(idx));
+				}
+			});
+			result.set_value(sum.load());
+		},
+		nullptr);
+
+	auto future = result.get_future();
+	P_CHECK(future.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	P_CHECK(future.get() == 4950);
+}
+
+P_TEST(threadpool_schedule_at)
+{
+	auto pool = create_pool(2);
+
+	auto                                                start = std::chrono::steady_clock::now();
+	std::promise<std::chrono::steady_clock::time_point> ran;
+	pool->schedule_at([&ran](threadpool_data_t) { ran.set_value(std::chrono::steady_clock::now()); }, nullptr,
+					  start + std::chrono::milliseconds(20));
+
+	// A task that is killed while it waits for its time never runs.
+	std::atomic_bool killed{false};
+	pool->pop(pool->schedule_at([&killed](threadpool_data_t) { killed = true; }, nullptr,
+								start + std::chrono::milliseconds(10)));
+
+	auto future = ran.get_future();
+	P_CHECK(future.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+	P_CHECK((future.get() - start) >= std::chrono::milliseconds(20));
+	P_CHECK(!killed.load());
+}
+
+P_TEST(threadpool_schedule_at_order)
+{
+	auto     pool = create_pool(1);
+	recorder tasks;
+
+	// Armed out of order, run in the order they are due.
+	auto start = std::chrono::steady_clock::now();
+	for (int idx : {3, 1, 4, 2}) {
+		pool->schedule_at([&tasks, idx](threadpool_data_t) { tasks.record(idx); }, nullptr,
+						  start + std::chrono::milliseconds(10 * idx));
+	}
+
+	P_CHECK(streamfx::test::wait_for([&tasks]() { return tasks.order().size() == 4; }));
+	P_CHECK(tasks.order() == std::vector<int>({1, 2, 3, 4}));
+}
+
+P_TEST(threadpool_schedule_every)
+{
+	auto             pool = create_pool(2);
+	std::atomic_int  runs{0};
+	std::atomic_int  concurrent{0};
+	std::atomic_bool overlapped{false};
+
+	auto task = pool->schedule_every(
+		[&](threadpool_data_t) {
+			if (concurrent.fetch_add(1) > 0) {
+				overlapped = true;
+			}
+			// Runs longer than the interval, which must skip runs instead of overlapping them.
+			std::this_thread::sleep_for(std::chrono::milliseconds(3));
+			concurrent.fetch_sub(1);
+			runs.fetch_add(1);
+		},
+		nullptr, std::chrono::milliseconds(1));
+
+	P_CHECK(streamfx::test::wait_for([&runs]() { return runs.load() >= 5; }));
+	pool->pop(task);
+
+	// Give a run that was already queued the chance to finish, then nothing may happen anymore.
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	int stopped = runs.load();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	P_CHECK(runs.load() == stopped);
+	P_CHECK(!overlapped.load());
+}
+
+P_TEST(threadpool_labels)
+{
+	auto pool  = create_pool(1);
+	auto group = pool->create_group();
+	for (std::size_t idx = 0; idx < 10; idx++) {
+		group->push([](threadpool_data_t) {}, nullptr, threadpool_priority::NORMAL,
+					streamfx::util::threadpool_deadline_t::max(), "Label");
+	}
+	group->wait();
+
+	P_CHECK(pool->statistics_report().find("Label") != std::string::npos);
+}
+
+P_TEST(threadpool_allocations)
+{
+	auto               pool = create_pool(1);
+	blocker            gate;
+	std::atomic_size_t done{0};
+
+	// Warm up with a burst of tasks that all exist at the same time.
+	gate.block(*pool);
+	for (std::size_t idx = 0; idx < 100; idx++) {
+		pool->push([&done](threadpool_data_t) { done.fetch_add(1); }, nullptr);
+	}
+	gate.release();
+	P_CHECK(streamfx::test::wait_for([&done]() { return done.load() == 100; }));
+	uint64_t warm = pool->allocations();
+
+	// From now on, small callables neither need the heap for themselves, nor for the task.
+	for (std::size_t idx = 1; idx <= 100; idx++) {
+		pool->push([&done](threadpool_data_t) { done.fetch_add(1); }, nullptr);
+		P_CHECK(streamfx::test::wait_for([&done, idx]() { return done.load() == (100 + idx); }));
+	}
+	P_CHECK(pool->allocations() == warm);
+
+	// Callables that don't fit are counted.
+	std::array<uint8_t, 256> large{};
+	pool->push([large, &done](threadpool_data_t) { done.fetch_add(large.size()); }, nullptr);
+	P_CHECK(streamfx::test::wait_for([&done]() { return done.load() == (200 + 256); }));
+	P_CHECK(pool->allocations() == (warm + 1));
+}
+
+P_TEST(threadpool_exceptions)
+{
+	// A throwing task must not take the worker down with it.
+	auto pool = create_pool(1);
+	pool->push([](threadpool_data_t) { throw std::runtime_error("expected"); }, nullptr);
+	pool->push([](threadpool_data_t) { throw 42; }, nullptr);
+
+	std::promise<void> after;
+	pool->push([&after](threadpool_data_t) { after.set_value(); }, nullptr);
+	P_CHECK(after.get_future().wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+}
@@ -0,0 +1,177 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include "test.hpp"
+#include <random>
+#include "util/utility.hpp"
+
+// Value that the helpers must never write, used to detect writes past the end of a row.
+#define ST_GUARD 0xA5
+
+static std::mt19937 random_engine(0x5F3759DF);
+
+static std::vector<uint16_t> random_samples(std::size_t count)
+{
+	std::uniform_int_distribution<uint32_t> distribution(0, 0xFFFF);
+	std::vector<uint16_t>                   samples(count);
+	for (auto& sample : samples) {
+		sample = static_cast<uint16_t>(distribution(random_engine));
+	}
+	return samples;
+}
+
+P_TEST(shift_row16)
+{
+	// Everything up to a few vectors, so that every possible tail after the 16 sample loop is covered.
+	for (std::size_t samples = 0; samples <= 70; samples++) {
+		for (uint8_t shift : {0, 1, 6, 15}) {
+			// Start one sample in, as rows of real frames are not necessarily aligned.
+			auto                  from = random_samples(samples + 1);
+			std::vector<uint16_t> to(samples + 2, ST_GUARD);
+			streamfx::util::shift_row16(to.data() + 1, from.data() + 1, samples, shift);
+
+			P_CHECK(to[0] == ST_GUARD);
+			for (std::size_t idx = 0; idx < samples; idx++) {
+				P_CHECK(to[idx + 1] == static_cast<uint16_t>(from[idx + 1] >> shift));
+			}
+			P_CHECK(to[samples + 1] == ST_GUARD);
+		}
+	}
+}
+
+P_TEST(shift_row16_in_place)
+{
+	auto samples  = random_samples(45);
+	auto expected = samples;
+	for (auto& sample : expected) {
+		sample >>= 6;
+	}
+
+	streamfx::util::shift_row16(samples.data(), samples.data(), samples.size(), 6);
+	P_CHECK(samples == expected);
+}
+
+P_TEST(deinterleave_row16)
+{
+	// Everything up to a few vectors, so that every possible tail after the 8 pair loop is covered.
+	for (std::size_t pairs = 0; pairs <= 40; pairs++) {
+		for (uint8_t shift : {0, 6, 15}) {
+			auto                  from = random_samples(pairs * 2 + 1);
+			std::vector<uint16_t> to_a(pairs + 2, ST_GUARD);
+			std::vector<uint16_t> to_b(pairs + 2, ST_GUARD);
+			streamfx::util::deinterleave_row16(to_a.data() + 1, to_b.data() + 1, from.data() + 1, pairs, shift);
+
+			P_CHECK((to_a[0] == ST_GUARD) && (to_b[0] == ST_GUARD));
+			for (std::size_t idx = 0; idx < pairs; idx++) {
+				P_CHECK(to_a[idx + 1] == static_cast<uint16_t>(from[idx * 2 + 1] >> shift));
+				P_CHECK(to_b[idx + 1] == static_cast<uint16_t>(from[idx * 2 + 2] >> shift));
+			}
+			P_CHECK((to_a[pairs + 1] == ST_GUARD) && (to_b[pairs + 1] == ST_GUARD));
+		}
+	}
+}
+
+P_TEST(p010_repack)
+{
+	// Repack a P010 frame into the separate, LSB-aligned planes of I010 the way the AOM AV1 encoder does. Only builds
+	// against libOBS 28 or newer hand the encoder P010 frames, so this keeps the path covered everywhere else.
+	for (std::size_t width : {1, 2, 17, 64, 1279, 1920}) {
+		std::size_t height   = 9;
+		std::size_t chroma_w = (width + 1) / 2;
+		std::size_t chroma_h = (height + 1) / 2;
+
+		// Rows padded differently on both sides, like the frames of libOBS and libaom are.
+		std::size_t stride_in  = width + 5;
+		std::size_t stride_out = width + 13;
+		auto        from_y     = random_samples(stride_in * height);
+		auto        from_uv    = random_samples(stride_in * chroma_h);
+		for (auto& sample : from_y) {
+			sample &= 0xFFC0;
+		}
+		for (auto& sample : from_uv) {
+			sample &= 0xFFC0;
+		}
+
+		std::vector<uint16_t> to_y(stride_out * height, ST_GUARD);
+		std::vector<uint16_t> to_u(stride_out * chroma_h, ST_GUARD);
+		std::vector<uint16_t> to_v(stride_out * chroma_h, ST_GUARD);
+		for (std::size_t y = 0; y < height; y++) {
+			streamfx::util::shift_row16(&to_y[stride_out * y], &from_y[stride_in * y], width, 6);
+		}
+		for (std::size_t y = 0; y < chroma_h; y++) {
+			streamfx::util::deinterleave_row16(&to_u[stride_out * y], &to_v[stride_out * y], &from_uv[stride_in * y],
+											   chroma_w, 6);
+		}
+
+		for (std::size_t y = 0; y < height; y++) {
+			for (std::size_t x = 0; x < stride_out; x++) {
+				uint16_t expected = (x < width) ? static_cast<uint16_t>(from_y[stride_in * y + x] >> 6) : ST_GUARD;
+				P_CHECK(to_y[stride_out * y + x] == expected);
+			}
+		}
+		for (std::size_t y = 0; y < chroma_h; y++) {
+			for (std::size_t x = 0; x < stride_out; x++) {
+				bool     inside = (x < chroma_w);
+				uint16_t u      = inside ? static_cast<uint16_t>(from_uv[stride_in * y + x * 2] >> 6) : ST_GUARD;
+				uint16_t v      = inside ? static_cast<uint16_t>(from_uv[stride_in * y + x * 2 + 1] >> 6) : ST_GUARD;
+				P_CHECK((to_u[stride_out * y + x] == u) && (to_v[stride_out * y + x] == v));
+			}
+		}
+	}
+}
+
+P_TEST(copy_plane)
+{
+	std::uniform_int_distribution<uint32_t> distribution(0, 0xFF);
+
+	// Sizes around the 16 byte alignment, the 64 byte loop and the size at which streaming stores take over.
+	for (std::size_t bytes : {0, 1, 15, 16, 17, 63, 64, 65, 255, 256, 257, 319, 1000, 4097}) {
+		for (std::size_t rows : {1, 2, 7}) {
+			for (std::size_t padding : {0, 3, 64}) {
+				// Shift the destination through every alignment, as streaming stores copy an unaligned head first.
+				for (std::size_t offset = 0; offset < 16; offset++) {
+					std::size_t from_stride = bytes + padding;
+					std::size_t to_stride   = bytes + (padding * 2);
+
+					std::vector<uint8_t> from(from_stride * rows + 1);
+					for (auto& value : from) {
+						value = static_cast<uint8_t>(distribution(random_engine));
+					}
+					std::vector<uint8_t> to(offset + to_stride * rows + 1, ST_GUARD);
+
+					streamfx::util::copy_plane(to.data() + offset, to_stride, from.data(), from_stride, bytes, rows);
+
+					bool matches = true;
+					for (std::size_t idx = 0; idx < offset; idx++) {
+						matches &= (to[idx] == ST_GUARD);
+					}
+					for (std::size_t y = 0; y < rows; y++) {
+						const uint8_t* row = to.data() + offset + to_stride * y;
+						matches &= (memcmp(row, from.data() + from_stride * y, bytes) == 0);
+						for (std::size_t x = bytes; x < to_stride; x++) {
+							matches &= (row[x] == ST_GUARD);
+						}
+					}
+					matches &= (to.back() == ST_GUARD);
+					P_CHECK(matches);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ * Modern effects for a modern Streamer
+ * Copyright (C) 2021 Michael Fabian Dirks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#pragma once
+#include "common.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace streamfx::test {
+	struct test_case {
+		const char* name;
+		void (*function)();
+		bool benchmark;
+	};
+
+	std::vector<test_case>& registry();
+
+	struct registrar {
+		registrar(const char* name, void (*function)(), bool benchmark = false)
+		{
+			registry().push_back({name, function, benchmark});
+		}
+	};
+
+	/** Report a failed check. Safe to call from any thread, the test keeps running and is marked as failed.
+	 */
+	void fail(const char* file, int line, const char* expression);
+
+	/** Poll 'condition' until it is true or 'timeout' has passed, and return the last result.
+	 */
+	bool wait_for(std::function<bool()> condition, std::chrono::milliseconds timeout = std::chrono::seconds(10));
+} // namespace streamfx::test
+
+#define P_TEST(name)                                                          \
+	static void                        test_##name();                         \
+	static ::streamfx::test::registrar registrar_##name(#name, &test_##name); \
+	static void                        test_##name()
+
+// Benchmarks only run if the executable is started with --benchmark, and report their results themselves.
+#define P_BENCHMARK(name)                                                                \
+	static void                        benchmark_##name();                               \
+	static ::streamfx::test::registrar registrar_##name(#name, &benchmark_##name, true); \
+	static void                        benchmark_##name()
+
+#define P_CHECK(expression)                                          \
+	do {                                                             \
+		if (!(expression)) {                                         \
+			::streamfx::test::fail(__FILE__, __LINE__, #expression); \
+		}                                                            \
+	} while (false)